@@ -0,0 +1,22 @@
+# Writes the SPIR-V binaries in SHADERS ("|" separated) to OUTPUT as constexpr word arrays plus a table naming
+# them, for src/embedded_shaders.cpp to include. Run with cmake -P
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(CONTENT "// generated by cmake/embed_shaders.cmake, do not edit\n\n")
+set(TABLE "")
+set(INDEX 0)
+foreach(SHADER ${SHADERS})
+    get_filename_component(FILE_NAME ${SHADER} NAME)
+    string(REGEX REPLACE "\\.spv$" "" SHADER_NAME ${FILE_NAME})
+
+    file(READ ${SHADER} BYTES HEX)
+    # SPIR-V words are stored little endian
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u," WORDS "${BYTES}")
+
+    string(APPEND CONTENT "static constexpr uint32_t SHADER_${INDEX}[] = {${WORDS}};\n")
+    string(APPEND TABLE "    {\"${SHADER_NAME}\", SHADER_${INDEX}, sizeof(SHADER_${INDEX})},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+string(APPEND CONTENT "\nstatic constexpr EmbeddedShader EMBEDDED_SHADERS[] = {\n${TABLE}};\n")
+file(WRITE ${OUTPUT} "${CONTENT}")
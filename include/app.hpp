@@ -4,8 +4,15 @@
 #include "device.hpp"
 #include "game_object.hpp"
 #include "renderer.hpp"
+#include "geometry_pool.hpp"
+#include "model_loader.hpp"
+#include "model_registry.hpp"
+#include "pipeline_manager.hpp"
+#include "descriptors.hpp"
 
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace hex
@@ -26,11 +33,23 @@ namespace hex
 
     private:
         void loadGameObjects();
+        // Adds an object right away and gives it its model once the registry has made it resident. Unshared
+        // objects bypass the registry and get a copy of their own, loaded and uploaded separately
+        void spawnGameObject(const std::string &modelname, const TransformComponent &transform, bool shared = true);
 
         Window window{WIDTH, HEIGHT, "HEX"};
         Device device{window};
         Renderer renderer{window, device};
+        PipelineManager pipelineManager{device};
+        // sets that live as long as the systems using them
+        DescriptorAllocator descriptorAllocator{device};
+        // one per frame in flight, reset when the frame comes around again
+        std::vector<std::unique_ptr<DescriptorAllocator>> frameDescriptorAllocators;
+        GeometryPool geometryPool{device};
+        ModelLoader modelLoader{geometryPool};
+        ModelRegistry modelRegistry{modelLoader};
 
         std::vector<GameObject> gameObjects;
+        std::chrono::high_resolution_clock::time_point startTime;
     };
 }
\ No newline at end of file
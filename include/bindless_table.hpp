@@ -0,0 +1,78 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace hex
+{
+    // One descriptor set holding large arrays of every sampled image, sampler and storage buffer in use, bound
+    // once per frame. Shaders pick resources by index, e.g. from per object data, so draws need no descriptor
+    // binds of their own. The arrays are update after bind and partially bound: slots are written while the set
+    // is in use by earlier frames, as long as those frames do not read them. Needs descriptor indexing
+    class BindlessTable
+    {
+    public:
+        enum Binding : uint32_t
+        {
+            SAMPLED_IMAGES = 0,
+            SAMPLERS = 1,
+            STORAGE_BUFFERS = 2,
+            BINDING_COUNT
+        };
+
+        // capacities before clamping to the device limits
+        static constexpr uint32_t MAX_SAMPLED_IMAGES = 16384;
+        static constexpr uint32_t MAX_SAMPLERS = 256;
+        static constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+        // slot 0 of every array, a white texel, a linear repeating sampler and 16 zero bytes
+        static constexpr uint32_t DEFAULT_INDEX = 0;
+
+        static bool isSupported(Device &device);
+
+        explicit BindlessTable(Device &device);
+        ~BindlessTable();
+
+        BindlessTable(const BindlessTable &) = delete;
+        BindlessTable &operator=(const BindlessTable &) = delete;
+
+        // Each returns the index shaders use, throws when the array is full
+        uint32_t addSampledImage(VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        uint32_t addSampler(VkSampler sampler);
+        uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        // Frees the slot for reuse, no frame in flight may still read it
+        void remove(Binding binding, uint32_t index);
+
+        VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+        VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+        uint32_t getCapacity(Binding binding) const { return slots[binding].capacity; }
+
+    private:
+        struct Slots
+        {
+            uint32_t capacity = 0;
+            uint32_t next = 0;
+            std::vector<uint32_t> freed;
+        };
+
+        void createSetLayout();
+        void createDescriptorSet();
+        void createDefaultResources();
+        uint32_t acquireSlot(Binding binding);
+        void write(Binding binding, uint32_t index, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo);
+
+        Device &device;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        Slots slots[BINDING_COUNT];
+
+        VkImage defaultImage = VK_NULL_HANDLE;
+        VkDeviceMemory defaultImageMemory = VK_NULL_HANDLE;
+        VkImageView defaultImageView = VK_NULL_HANDLE;
+        VkSampler defaultSampler = VK_NULL_HANDLE;
+        VkBuffer defaultBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory defaultBufferMemory = VK_NULL_HANDLE;
+    };
+}
@@ -22,6 +22,10 @@ namespace hex
         }
         const glm::mat4 &getView() const { return viewMatrix; }
 
+        // Screen height, in normalized device units (the viewport spans 2), covered by a world space length
+        // seen at the given view space depth
+        float projectedScreenSize(float worldSize, float viewDepth) const;
+
     private:
         glm::mat4 projectionMatrix{1.0f};
         glm::mat4 viewMatrix{1.0f};
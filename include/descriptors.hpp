@@ -0,0 +1,96 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace hex
+{
+    // Hands out one descriptor set layout per distinct set of bindings, whatever order they are listed in
+    class DescriptorLayoutCache
+    {
+    public:
+        explicit DescriptorLayoutCache(Device &device);
+        ~DescriptorLayoutCache();
+
+        DescriptorLayoutCache(const DescriptorLayoutCache &) = delete;
+        DescriptorLayoutCache &operator=(const DescriptorLayoutCache &) = delete;
+
+        VkDescriptorSetLayout getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+    private:
+        Device &device;
+        struct CachedLayout
+        {
+            // sorted by binding number, kept to confirm hash hits
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        };
+
+        std::mutex mutex;
+        std::unordered_multimap<size_t, CachedLayout> layouts;
+    };
+
+    // Allocates descriptor sets from a growing list of pools and never frees sets one by one: reset returns every
+    // pool at once. Keep one per frame in flight for sets that live a frame, and one that is never reset for
+    // long lived sets. Not thread safe
+    class DescriptorAllocator
+    {
+    public:
+        // Descriptors of a type per set, pools are sized from these
+        struct PoolRatio
+        {
+            VkDescriptorType type;
+            float perSet;
+        };
+
+        static const std::vector<PoolRatio> DEFAULT_RATIOS;
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        explicit DescriptorAllocator(Device &device, uint32_t setsPerPool = 64, std::vector<PoolRatio> ratios = DEFAULT_RATIOS);
+        ~DescriptorAllocator();
+
+        DescriptorAllocator(const DescriptorAllocator &) = delete;
+        DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+
+        // Moves on to a new pool, each larger than the last, when the current one runs out
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+        // Every set allocated so far becomes invalid; the GPU must be done with them
+        void reset();
+
+        // Prints the per frame cost of allocating setsPerFrame sets with the allocator against allocating and
+        // freeing them individually from one pool
+        static void benchmark(Device &device, DescriptorLayoutCache &layoutCache, uint32_t setsPerFrame = 4096, uint32_t frames = 64);
+
+    private:
+        VkDescriptorPool grabPool();
+        VkDescriptorPool createPool(uint32_t setCount);
+
+        Device &device;
+        std::vector<PoolRatio> ratios;
+        uint32_t setsPerPool;
+        VkDescriptorPool currentPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> fullPools;
+        std::vector<VkDescriptorPool> freePools;
+    };
+
+    // Collects the writes for a descriptor set and applies them in one vkUpdateDescriptorSets call
+    class DescriptorWriter
+    {
+    public:
+        DescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        DescriptorWriter &writeImage(uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+
+        void update(Device &device, VkDescriptorSet set);
+
+    private:
+        // deques keep the infos in place while the writes point at them
+        std::deque<VkDescriptorBufferInfo> bufferInfos;
+        std::deque<VkDescriptorImageInfo> imageInfos;
+        std::vector<VkWriteDescriptorSet> writes;
+    };
+}
@@ -1,13 +1,43 @@
 #pragma once
 
 #include "window.hpp"
+#include "shader_reflection.hpp"
 
 // std lib headers
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace hex
 {
+    enum class QueueType
+    {
+        Graphics,
+        Transfer,
+        Compute
+    };
+
+    // A position on the GPU timeline: one value per queue, 0 where nothing needs to complete. Points from several
+    // submissions combine by taking the later value of each queue
+    struct TimelinePoint
+    {
+        static constexpr size_t QUEUE_COUNT = 3;
+        std::array<uint64_t, QUEUE_COUNT> values{};
+
+        void merge(const TimelinePoint &other)
+        {
+            for (size_t i = 0; i < QUEUE_COUNT; i++)
+            {
+                values[i] = values[i] > other.values[i] ? values[i] : other.values[i];
+            }
+        }
+    };
 
     struct SwapChainSupportDetails
     {
@@ -20,11 +50,44 @@ namespace hex
     {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        // only families without graphics: copy engines and async compute, absent on many devices
+        uint32_t transferFamily;
+        uint32_t computeFamily;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
+        bool computeFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // What the logical device was created with, render systems check these to pick their fast paths. Every
+    // feature set here is enabled
+    struct DeviceCapabilities
+    {
+        // the lower of what the instance asked for and what the device supports
+        uint32_t apiVersion = VK_API_VERSION_1_0;
+        bool multiDrawIndirect = false;
+        bool fillModeNonSolid = false;
+        // 1.1
+        bool shaderDrawParameters = false;
+        // 1.2; runtime sized, partially bound, update after bind descriptor arrays
+        bool descriptorIndexing = false;
+        bool timelineSemaphore = false;
+        bool drawIndirectCount = false;
+        bool hostQueryReset = false;
+        // 1.3
+        bool synchronization2 = false;
+        bool dynamicRendering = false;
+        bool maintenance4 = false;
+        // the driver only implements a subset of Vulkan, e.g. on top of Metal
+        bool portabilitySubset = false;
+        // VK_EXT_swapchain_maintenance1: presents can signal a fence once the swapchain is done with their image
+        bool swapchainMaintenance1 = false;
+        // queues of their own next to the graphics queue, see Device::transferQueue and computeQueue
+        bool dedicatedTransferQueue = false;
+        bool asyncComputeQueue = false;
+    };
+
     class Device
     {
     public:
@@ -48,21 +111,33 @@ namespace hex
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        // VK_NULL_HANDLE, as are their pools, without the matching capability. Buffers they write and the graphics
+        // queue reads need a queue family ownership transfer, or concurrent sharing
+        VkQueue transferQueue() { return transferQueue_; }
+        VkQueue computeQueue() { return computeQueue_; }
+        VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+        VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+        const QueueFamilyIndices &getQueueFamilies() const { return selectedQueueFamilies; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        // Same without throwing, for memory kinds that are only nice to have such as lazily allocated memory
+        bool tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &typeIndex);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(
             const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
+        // Buffers are exclusive to one queue family unless concurrentFamilies names several distinct ones
         void createBuffer(
             VkDeviceSize size,
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags properties,
             VkBuffer &buffer,
-            VkDeviceMemory &bufferMemory);
+            VkDeviceMemory &bufferMemory,
+            const std::vector<uint32_t> &concurrentFamilies = {});
         VkCommandBuffer beginSingleTimeCommands();
+        // Submits and waits for just this command buffer, not the whole queue
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
         void copyBufferToImage(
@@ -74,7 +149,44 @@ namespace hex
             VkImage &image,
             VkDeviceMemory &imageMemory);
 
+        // Shader library: each shaders/<name>.spv, or its embedded copy, is read and turned into a module once,
+        // pipelines borrow the modules for the lifetime of the device. Identical binaries under different names
+        // share one module
+        VkShaderModule getShaderModule(const std::string &shaderName);
+        // Reads shaders/<name>.spv again and returns whether it changed. Pipelines created from the previous
+        // module keep working and may still be compiling elsewhere, so it lives on until the device is destroyed
+        bool reloadShaderModule(const std::string &shaderName);
+        // Interface of the shader's current module, loading it if needed
+        ShaderReflection getShaderReflection(const std::string &shaderName);
+
+        // GPU timeline. Every submission made through submit signals the next value of its queue's timeline
+        // semaphore, so whatever it used can be reused or freed once the GPU has passed the returned point,
+        // without a fence per submission. Without timeline semaphore support pooled fences stand in for them.
+        // submitInfo must not chain its own VkTimelineSemaphoreSubmitInfo
+        TimelinePoint submit(QueueType queue, const VkSubmitInfo &submitInfo);
+        // Everything submitted so far, on every queue
+        TimelinePoint getSubmittedPoint();
+        bool isComplete(const TimelinePoint &point);
+        // Blocks without holding the timeline lock; throws for points beyond what has been submitted
+        void waitFor(const TimelinePoint &point);
+        // Runs reclaim from collectCompleted once the GPU has passed point, e.g. to free staging memory
+        void reclaimAfter(const TimelinePoint &point, std::function<void()> reclaim);
+        // Runs what reclaimAfter queued and the GPU has finished with, once per frame is enough
+        void collectCompleted();
+        // Everything submitted so far plus the graphics submission still being recorded: nothing recorded up to
+        // now can use an object any more once the GPU has passed it
+        TimelinePoint getRetirePoint();
+        // Deletion queue: vkDestroy*/vkFree* calls for objects frames in flight may still use. destroy must only
+        // capture handles, it can run as late as the device's destruction
+        void destroyDeferred(std::function<void()> destroy) { reclaimAfter(getRetirePoint(), std::move(destroy)); }
+
         VkPhysicalDeviceProperties properties;
+        DeviceCapabilities capabilities{};
+        VkQueueFlags graphicsQueueFlags = 0;
+        // 0 when the graphics queue cannot write timestamps
+        uint32_t graphicsQueueTimestampBits = 0;
+        // only filled in with capabilities.descriptorIndexing
+        VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
 
     private:
         void createInstance();
@@ -83,9 +195,33 @@ namespace hex
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void createTimelines();
+        void destroyTimelines();
+
+        // enabled features, chained through pNext as far as the device's version allows
+        struct FeatureChain
+        {
+            VkPhysicalDeviceFeatures2 features{};
+            VkPhysicalDeviceVulkan11Features vulkan11{};
+            VkPhysicalDeviceVulkan12Features vulkan12{};
+            VkPhysicalDeviceVulkan13Features vulkan13{};
+#ifdef VK_EXT_swapchain_maintenance1
+            VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1{};
+#endif
+        };
+        // Fills in capabilities and enabled with the supported subset of what the engine can use
+        void negotiateFeatures(FeatureChain &enabled);
+        // The required device extensions plus the optional ones present, chaining the features of those that
+        // have any into enabled
+        std::vector<const char *> negotiateExtensions(FeatureChain &enabled);
+        void logCapabilities() const;
+        bool hasInstanceExtension(const char *extensionName);
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
+        // 0 for unsuitable devices, otherwise higher is faster: by type (discrete, integrated, virtual, cpu), then
+        // device local memory, then queue families and API version
+        uint64_t scorePhysicalDevice(VkPhysicalDevice device);
         std::vector<const char *> getRequiredExtensions();
         bool checkValidationLayerSupport();
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
@@ -93,20 +229,65 @@ namespace hex
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+        // shaderMutex must be held. Prefers the copy compiled into the executable when allowed and present
+        VkShaderModule loadShaderModule(const std::string &shaderName, bool allowEmbedded);
+        void destroyShaderModules();
 
         VkInstance instance;
+        uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+        // the instance extensions swapchain maintenance1 depends on were enabled
+        bool surfaceMaintenance1 = false;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         Window &window;
         VkCommandPool commandPool;
+        VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+        VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+        QueueFamilyIndices selectedQueueFamilies{};
 
         VkDevice device_;
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_ = VK_NULL_HANDLE;
+        VkQueue computeQueue_ = VK_NULL_HANDLE;
+
+        struct QueueTimeline
+        {
+            VkQueue queue = VK_NULL_HANDLE;
+            // VK_NULL_HANDLE without timeline semaphores, then every submission gets a fence from fencePool
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            uint64_t submittedValue = 0;
+            uint64_t completedValue = 0;
+            std::deque<std::pair<uint64_t, VkFence>> pendingFences;
+        };
+        // timelineMutex must be held
+        uint64_t pollCompletedValue(QueueTimeline &timeline);
+
+        std::mutex timelineMutex;
+        std::array<QueueTimeline, TimelinePoint::QUEUE_COUNT> timelines{};
+        std::vector<VkFence> fencePool;
+        // fences waitFor is waiting on outside the lock, by number of waiters
+        std::unordered_map<VkFence, uint32_t> fenceWaiters;
+        std::vector<std::pair<TimelinePoint, std::function<void()>>> pendingReclaims;
+
+        std::mutex shaderMutex;
+        std::unordered_map<std::string, VkShaderModule> shaderModules;
+        struct CachedShaderModule
+        {
+            // kept to confirm hash hits, different code with the same hash gets its own module
+            std::vector<char> code;
+            VkShaderModule module = VK_NULL_HANDLE;
+        };
+        std::unordered_multimap<uint64_t, CachedShaderModule> shaderModulesByHash;
+        std::unordered_map<std::string, ShaderReflection> shaderReflections;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-        const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_KHR_portability_subset"};
+        // spelled out, the header only defines the name with beta extensions enabled
+        static constexpr const char *PORTABILITY_SUBSET_EXTENSION_NAME = "VK_KHR_portability_subset";
+        const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        // enabled when present; the spec requires enabling portability subset wherever it is exposed
+        const std::vector<const char *> optionalDeviceExtensions = {PORTABILITY_SUBSET_EXTENSION_NAME};
     };
 
 }
\ No newline at end of file
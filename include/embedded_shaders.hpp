@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace hex
+{
+    // SPIR-V compiled into the executable, see HEX_EMBED_SHADERS in CMakeLists.txt
+    struct EmbeddedShader
+    {
+        const char *name;
+        const uint32_t *code;
+        size_t size;
+    };
+
+    // nullptr unless the build embedded the shader, e.g. simple.vert
+    const EmbeddedShader *findEmbeddedShader(const std::string &shaderName);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hex
+{
+    // Read-only view of a whole file. Memory maps it where the platform allows, so reading costs no copy and
+    // pages are faulted in on first touch; otherwise, or when mapping fails, the file is read into a buffer.
+    // Either way the data stays valid, and aligned well enough for SPIR-V words, for the lifetime of the view
+    class FileView
+    {
+    public:
+        enum class Mode
+        {
+            Mapped,
+            Buffered
+        };
+
+        // Throws when the file cannot be opened
+        explicit FileView(const std::string &filepath, Mode mode = Mode::Mapped);
+        ~FileView();
+
+        FileView(const FileView &) = delete;
+        FileView &operator=(const FileView &) = delete;
+        FileView(FileView &&other) noexcept;
+        FileView &operator=(FileView &&other) noexcept;
+
+        const char *data() const { return bytes; }
+        size_t size() const { return length; }
+        bool isMapped() const { return mapped; }
+
+        // Prints the read throughput of the ifstream, buffered and mapped paths over the file, each pass
+        // touching every byte so the mapped view actually faults its pages in
+        static void benchmark(const std::string &filepath, uint32_t iterations = 8);
+
+    private:
+        bool map(const std::string &filepath);
+        void read(const std::string &filepath);
+        void release();
+
+        const char *bytes = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::vector<char> buffer;
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "device.hpp"
+#include "swap_chain.hpp"
+
+#include <cstdint>
+
+namespace hex
+{
+    // One persistently mapped, host visible buffer split into a region per frame in flight. A frame fills its own
+    // region from the front and shaders find the data through dynamic offsets, so the CPU never writes what the
+    // GPU may still be reading and one descriptor set serves every frame
+    class FrameBufferRing
+    {
+    public:
+        struct Allocation
+        {
+            void *data;
+            // from the start of the buffer, ready to be passed as a dynamic offset
+            uint32_t offset;
+        };
+
+        FrameBufferRing(Device &device, VkDeviceSize frameSize, VkBufferUsageFlags usage, uint32_t frameCount = SwapChain::MAX_FRAMES_IN_FLIGHT);
+        ~FrameBufferRing();
+
+        FrameBufferRing(const FrameBufferRing &) = delete;
+        FrameBufferRing &operator=(const FrameBufferRing &) = delete;
+
+        // Starts over in the frame's region; its previous frame must have finished on the GPU
+        void beginFrame(uint32_t frameIndex);
+        // Aligned for uniform and storage buffer offsets. Throws when the frame's region is exhausted
+        Allocation allocate(VkDeviceSize size);
+
+        VkBuffer getBuffer() const { return buffer; }
+
+    private:
+        Device &device;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        char *mapped = nullptr;
+        VkDeviceSize alignment = 1;
+        VkDeviceSize frameSize = 0;
+        VkDeviceSize frameBegin = 0;
+        VkDeviceSize cursor = 0;
+    };
+}
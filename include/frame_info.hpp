@@ -0,0 +1,21 @@
+#pragma once
+
+#include "camera.hpp"
+#include "descriptors.hpp"
+
+#include <vulkan/vulkan.h>
+
+namespace hex
+{
+    // What render systems need to know about the frame being recorded
+    struct FrameInfo
+    {
+        int frameIndex;
+        // seconds since the app started
+        float time;
+        VkCommandBuffer commandBuffer;
+        const Camera &camera;
+        // for sets needed only this frame, they stay valid until the frame index comes around again
+        DescriptorAllocator &frameDescriptors;
+    };
+}
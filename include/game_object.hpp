@@ -41,6 +41,41 @@ struct TransformComponent
             },
             {translation.x, translation.y, translation.z, 1.0f}};
     }
+
+    // Inverse transpose of mat4's rotation and scale, keeps normals perpendicular under non-uniform scale
+    glm::mat3 normalMatrix()
+    {
+        const float c3 = glm::cos(rotation.z);
+        const float s3 = glm::sin(rotation.z);
+        const float c2 = glm::cos(rotation.x);
+        const float s2 = glm::sin(rotation.x);
+        const float c1 = glm::cos(rotation.y);
+        const float s1 = glm::sin(rotation.y);
+        const glm::vec3 inverseScale = 1.0f / scale;
+        return glm::mat3{
+            {
+                inverseScale.x * (c1 * c3 + s1 * s2 * s3),
+                inverseScale.x * (c2 * s3),
+                inverseScale.x * (c1 * s2 * s3 - c3 * s1),
+            },
+            {
+                inverseScale.y * (c3 * s1 * s2 - c1 * s3),
+                inverseScale.y * (c2 * c3),
+                inverseScale.y * (c1 * c3 * s2 + s1 * s3),
+            },
+            {
+                inverseScale.z * (c2 * s1),
+                inverseScale.z * (-s2),
+                inverseScale.z * (c1 * c2),
+            }};
+    }
+};
+
+// Indices into the bindless table, BindlessTable::DEFAULT_INDEX (0) until a material is assigned
+struct MaterialComponent
+{
+    uint32_t texture = 0;
+    uint32_t sampler = 0;
 };
 
 namespace hex
@@ -61,11 +96,12 @@ namespace hex
         GameObject(GameObject &&) = default;
         GameObject &operator=(GameObject &&) = default;
 
-        id_t getId() { return id; }
+        id_t getId() const { return id; }
 
         std::shared_ptr<Model> model{};
         glm::vec3 color{};
         TransformComponent transform{};
+        MaterialComponent material{};
 
     private:
         GameObject(id_t objId) : id{objId} {};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "device.hpp"
+#include "model.hpp"
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace hex
+{
+    struct GeometryRange
+    {
+        uint32_t offset = 0;
+        uint32_t count = 0;
+    };
+
+    struct GeometryAllocation
+    {
+        GeometryRange vertices{};
+        GeometryRange indices{};
+        GeometryRange meshlets{};
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+    };
+
+    // Sub-allocates the vertices, indices and meshlets of every model out of a few large device local buffers so
+    // draw loops bind geometry once per frame. Indices stay relative to the model's first vertex; models with fewer
+    // than 65536 vertices (or split into 16-bit chunks) go to the 16-bit index buffer, the rest to the 32-bit one
+    class GeometryPool
+    {
+    public:
+        static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1u << 20;
+        static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1u << 22;
+        static constexpr uint32_t DEFAULT_MESHLET_CAPACITY = 1u << 16;
+
+        // Staging copies of one or more models recorded into one command buffer; their geometry may only be drawn
+        // once the GPU timeline has passed completion. With a dedicated transfer queue the copies run there, and the
+        // graphics queue takes ownership of the written ranges in acquireCommandBuffer once transferComplete signals
+        struct UploadBatch
+        {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+            VkSemaphore transferComplete = VK_NULL_HANDLE;
+            TimelinePoint completion{};
+            VkBuffer stagingBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+        };
+
+        GeometryPool(
+            Device &device,
+            uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+            uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY,
+            uint32_t meshletCapacity = DEFAULT_MESHLET_CAPACITY);
+        ~GeometryPool();
+
+        GeometryPool(const GeometryPool &) = delete;
+        GeometryPool &operator=(const GeometryPool &) = delete;
+
+        // Reserves space for the builder's geometry and uploads it in a single transfer, waiting for it to finish.
+        // Meshlet index ranges are rebased onto the pool so culling can write draws without knowing which model
+        // they belong to
+        GeometryAllocation allocate(const Model::Builder &builder);
+        // Same for several builders sharing one staging buffer and one submission, returns without waiting.
+        // Nothing is allocated if any of them does not fit
+        std::vector<GeometryAllocation> allocate(const std::vector<const Model::Builder *> &builders, UploadBatch &batch);
+        bool isUploadComplete(const UploadBatch &batch) const;
+        // Hands the batch's staging resources to the device, which frees them once the upload has completed;
+        // never waits
+        void finishUpload(UploadBatch &batch);
+        // The ranges become available again once frames in flight, which may still draw from them, have retired
+        void free(const GeometryAllocation &allocation);
+
+        // Bytes a builder occupies in a staging buffer
+        static VkDeviceSize getUploadSize(const Model::Builder &builder);
+
+        void bindVertexBuffer(VkCommandBuffer commandBuffer);
+        void bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+        Device &getDevice() { return device; }
+        VkBuffer getMeshletBuffer() const { return meshletBuffer; }
+        uint32_t getVertexUsage() const { return vertexAllocator.used(); }
+        uint32_t getIndexUsage(VkIndexType indexType) const;
+
+    private:
+        // First fit over free ranges kept sorted by offset, neighbours are merged on free
+        class RangeAllocator
+        {
+        public:
+            explicit RangeAllocator(uint32_t capacity);
+
+            bool allocate(uint32_t count, GeometryRange &range);
+            void free(const GeometryRange &range);
+            uint32_t used() const { return usedCount; }
+
+        private:
+            std::map<uint32_t, uint32_t> freeRanges;
+            uint32_t usedCount = 0;
+        };
+
+        VkCommandBuffer beginUploadCommands(VkCommandPool commandPool);
+        void release(const GeometryAllocation &allocation);
+        // hands retired allocations whose frames the GPU has finished back to the range allocators
+        void releaseRetired();
+
+        Device &device;
+
+        VkBuffer vertexBuffer;
+        VkDeviceMemory vertexBufferMemory;
+        VkBuffer index16Buffer;
+        VkDeviceMemory index16BufferMemory;
+        VkBuffer index32Buffer;
+        VkDeviceMemory index32BufferMemory;
+        VkBuffer meshletBuffer;
+        VkDeviceMemory meshletBufferMemory;
+
+        RangeAllocator vertexAllocator;
+        RangeAllocator index16Allocator;
+        RangeAllocator index32Allocator;
+        RangeAllocator meshletAllocator;
+        // freed while possibly still in use, oldest first
+        std::deque<std::pair<TimelinePoint, GeometryAllocation>> retired;
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "device.hpp"
+#include "swap_chain.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace hex
+{
+    // Measures GPU time between two points of a frame's command buffer with timestamp queries. Every frame in
+    // flight has its own pair of queries, read back without waiting when the slot comes around again
+    class GpuTimer
+    {
+    public:
+        // Timestamps on the graphics queue are all the timer needs
+        static bool isSupported(Device &device);
+
+        explicit GpuTimer(Device &device, uint32_t frameCount = SwapChain::MAX_FRAMES_IN_FLIGHT);
+        ~GpuTimer();
+
+        GpuTimer(const GpuTimer &) = delete;
+        GpuTimer &operator=(const GpuTimer &) = delete;
+
+        // Both outside of a render pass; begin picks up what the slot measured last time first
+        void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        void end(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        // Milliseconds between begin and end of the most recently completed frame, negative until there is one
+        float getLastMilliseconds() const { return lastMilliseconds; }
+
+    private:
+        void readResults(uint32_t frameIndex);
+
+        Device &device;
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<bool> written;
+        uint64_t timestampMask = 0;
+        float lastMilliseconds = -1.0f;
+    };
+}
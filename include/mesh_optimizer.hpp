@@ -0,0 +1,64 @@
+#pragma once
+
+#include "mesh_types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace hex
+{
+    struct VertexCacheStatistics
+    {
+        // average cache miss ratio: transformed vertices per triangle (0.5 is the ideal, 3.0 the worst)
+        float acmr = 0.0f;
+        // average transformed vertex ratio: transformed vertices per referenced vertex (1.0 is the ideal)
+        float atvr = 0.0f;
+    };
+
+    class MeshOptimizer
+    {
+    public:
+        static constexpr uint32_t DEFAULT_CACHE_SIZE = 16;
+
+        // Simulates a FIFO post-transform cache of the given size over the index buffer
+        static VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+        // Tipsify (Sander, Nehab, Barczak 2007) triangle reordering for the post-transform cache
+        static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+        // Splits cache optimized indices into clusters at cache flushes and draws the clusters facing away
+        // from the mesh centre first, so early depth testing rejects more of the fragments behind them
+        static void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+        // Renumbers vertices in the order the index buffer first references them so vertex fetch walks
+        // memory linearly; unreferenced vertices are dropped
+        static void optimizeVertexFetch(std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices);
+
+        // Quadric error metric simplification by half-edge collapse, so the result only references existing
+        // vertices and can share the vertex buffer with the full detail mesh. Vertices are welded by position,
+        // open borders are held in place by perpendicular constraint planes. targetError and resultError are
+        // relative to the largest extent of the mesh bounding box; no collapse above targetError is performed
+        static std::vector<uint32_t> simplify(
+            const std::vector<uint32_t> &indices,
+            const std::vector<MeshVertex> &vertices,
+            size_t targetIndexCount,
+            float targetError,
+            float *resultError = nullptr);
+
+        // Coarsest level whose error, scaled to the screen by screenSizePerUnit, stays within maxScreenError.
+        // Level 0 is the full detail mesh and always qualifies
+        static uint32_t selectLod(const std::vector<MeshLod> &lods, float screenSizePerUnit, float maxScreenError);
+
+        // Greedily grows meshlets of at most maxVertices unique vertices and maxTriangles triangles over
+        // [firstIndex, firstIndex + indexCount), preferring triangles that add the fewest new vertices and lie
+        // closest to the meshlet. The range is rewritten in meshlet order; bounds and normal cones are filled in,
+        // with cones disabled unless the mesh is closed since the pipeline does not cull back faces
+        static std::vector<Meshlet> buildMeshlets(
+            std::vector<uint32_t> &indices,
+            const std::vector<MeshVertex> &vertices,
+            uint32_t firstIndex,
+            uint32_t indexCount,
+            uint32_t maxVertices,
+            uint32_t maxTriangles);
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace hex
+{
+    // Plain mesh data shared by Model and the mesh processing passes, kept free of Vulkan so the passes can be
+    // built and tested on their own
+
+    struct MeshVertex
+    {
+        glm::vec3 position;
+        glm::vec3 color;
+        glm::vec3 normal{};
+        glm::vec2 uv{};
+
+        bool operator==(const MeshVertex &other) const
+        {
+            return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
+        }
+    };
+
+    // Contiguous run of indices drawn with its own base vertex, indices inside are relative to vertexOffset
+    struct MeshIndexRange
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        int32_t vertexOffset = 0;
+    };
+
+    // Cluster of triangles stored contiguously in the index buffer, laid out to match the std430 Meshlet
+    // struct of meshlet_cull.comp
+    struct Meshlet
+    {
+        // object space bounding sphere
+        glm::vec3 center{};
+        float radius = 0.0f;
+        // every triangle faces away from viewers inside the cone around -coneAxis; a cutoff of 1 never culls
+        glm::vec3 coneAxis{};
+        float coneCutoff = 1.0f;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        int32_t vertexOffset = 0;
+        uint32_t padding = 0;
+    };
+
+    struct MeshLod
+    {
+        MeshIndexRange range{};
+        // object space error bound of this level against the full detail mesh
+        float error = 0.0f;
+        // meshlets partitioning range, none when the mesh was not clustered
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "game_object.hpp"
+#include "camera.hpp"
+#include "swap_chain.hpp"
+#include "geometry_pool.hpp"
+#include "pipeline_manager.hpp"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace hex
+{
+    // Culls the meshlets of every clustered model against the frustum and their normal cones in a compute pass
+    // and writes one indirect draw per meshlet, so the classic vertex pipeline only rasterizes visible clusters.
+    // Needs no mesh shader support; devices without multiDrawIndirect issue the draws one by one. With an async
+    // compute queue the pass runs there, overlapping whatever the graphics queue still has in flight
+    class MeshletCullingSystem
+    {
+    public:
+        static constexpr uint32_t MAX_DRAWS_PER_FRAME = 1u << 16;
+        static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+        struct CullStats
+        {
+            uint32_t meshlets = 0;
+            uint32_t visibleMeshlets = 0;
+            uint32_t visibleTriangles = 0;
+        };
+
+        // Compute on the graphics queue is all the pass needs
+        static bool isSupported(Device &device);
+
+        // Sets come from descriptorAllocator, which must never be reset while the system lives
+        MeshletCullingSystem(Device &device, GeometryPool &geometryPool, PipelineManager &pipelineManager, DescriptorAllocator &descriptorAllocator);
+        ~MeshletCullingSystem();
+
+        MeshletCullingSystem(const MeshletCullingSystem &) = delete;
+        MeshletCullingSystem &operator=(const MeshletCullingSystem &) = delete;
+
+        // Records the culling dispatches for this frame into commandBuffer, outside of a render pass. On the async
+        // compute queue they are submitted right away instead, and the returned semaphore must be waited on at
+        // the draw indirect stage by the frame's graphics submission; VK_NULL_HANDLE when there is nothing to wait for
+        VkSemaphore cull(VkCommandBuffer commandBuffer, int frameIndex, std::vector<GameObject> &gameObjects, const Camera &camera);
+        // Issues the indirect draws culled for the game object this frame, false if it was not culled here
+        bool draw(VkCommandBuffer commandBuffer, const GameObject &gameObject) const;
+
+        // Results of the last frame the GPU finished with this frame slot
+        const CullStats &getStats() const { return stats; }
+
+        // Rebuilds the pipeline from the current shader module, between frames. The one it replaces stays in the
+        // pipeline manager, so frames still in flight are unaffected
+        void reloadPipeline();
+
+    private:
+        struct FrameResources
+        {
+            VkBuffer drawBuffer;
+            VkDeviceMemory drawBufferMemory;
+            VkBuffer statsBuffer;
+            VkDeviceMemory statsBufferMemory;
+            uint32_t *mappedStats;
+            VkDescriptorSet descriptorSet;
+            uint32_t submittedMeshlets = 0;
+            // async compute only
+            VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+            VkSemaphore cullFinished = VK_NULL_HANDLE;
+        };
+
+        struct DrawRange
+        {
+            uint32_t firstDraw;
+            uint32_t drawCount;
+        };
+
+        void createFrameResources();
+        void createPipelineLayout();
+        void createPipeline();
+        void createMeshletDescriptorSet();
+        void createAsyncComputeResources();
+
+        Device &device;
+        GeometryPool &geometryPool;
+        PipelineManager &pipelineManager;
+        DescriptorAllocator &descriptorAllocator;
+        // all owned by the pipeline manager, the layouts are reflected from meshlet_cull.comp
+        std::shared_ptr<Pipeline> pipeline;
+        VkPipelineLayout pipelineLayout;
+        VkDescriptorSetLayout meshletSetLayout;
+        VkDescriptorSetLayout frameSetLayout;
+        VkDescriptorSet meshletDescriptorSet;
+
+        std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+        std::unordered_map<GameObject::id_t, DrawRange> drawRanges;
+        int currentFrame = 0;
+        CullStats stats{};
+    };
+}
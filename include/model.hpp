@@ -1,67 +1,132 @@
 #pragma once
 
 #include "device.hpp"
-
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
+#include "mesh_types.hpp"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace hex
 {
+    class GeometryPool;
+    struct GeometryAllocation;
+
+    // Handle to a model's geometry inside a GeometryPool: the pool owns the buffers, the model only knows where its
+    // vertices, indices and meshlets start
     class Model
     {
     public:
-        struct Vertex
-        {
-            glm::vec3 position;
-            glm::vec3 color;
-            glm::vec3 normal{};
-            glm::vec2 uv{};
-
-            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
-            bool operator==(const Vertex &other) const
-            {
-                return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
-            }
-        };
+        static constexpr uint32_t MAX_16BIT_INDEXED_VERTICES = 1u << 16;
+        static constexpr uint32_t MAX_LOD_COUNT = 5;
+        static constexpr uint32_t MIN_LOD_TRIANGLES = 64;
+        static constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+        static constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+        using Vertex = MeshVertex;
+        using IndexRange = MeshIndexRange;
+        using Meshlet = hex::Meshlet;
+        using Lod = MeshLod;
+
+        static std::vector<VkVertexInputBindingDescription> getVertexBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getVertexAttributeDescriptions();
 
         struct Builder
         {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
-
-            void loadModel(const std::string &modelname);
+            // empty means the whole index buffer is a single range with vertexOffset 0
+            std::vector<IndexRange> chunks{};
+            // empty means a single level of detail covering the whole index buffer
+            std::vector<Lod> lods{};
+            std::vector<Meshlet> meshlets{};
+            bool optimized = false;
+            // set by loadModel, zero for hand built geometry that should never be deduplicated
+            uint64_t contentHash = 0;
+
+            // Loads models/<modelname>.obj, going through the baked models/<modelname>.mesh cache when it is
+            // up to date, so the optimization passes only run once per source change
+            void loadModel(const std::string &modelname, bool optimizeMesh = true);
+            // Vertex cache, overdraw and vertex fetch reordering; prints ACMR/ATVR before and after
+            void optimize();
+            // Splits meshes with more than maxChunkVertices vertices into chunks whose local indices fit in
+            // 16 bits, duplicating the vertices shared across chunk borders
+            void splitIndexChunks(uint32_t maxChunkVertices = MAX_16BIT_INDEXED_VERTICES);
+            // Appends successively halved simplifications of the mesh to indices, sharing the vertex buffer.
+            // maxRelativeError is relative to the largest bounding box extent and bounds how far each level's surface
+            // strays from the full detail one, see tests/mesh_simplify_test.cpp
+            void generateLods(uint32_t maxLodCount = MAX_LOD_COUNT, float maxRelativeError = 0.02f);
+            // Partitions every level of detail into meshlets, reordering its indices so each meshlet is a
+            // contiguous range; run after generateLods
+            void generateMeshlets(uint32_t maxVertices = MAX_MESHLET_VERTICES, uint32_t maxTriangles = MAX_MESHLET_TRIANGLES);
+            // Non-zero hash of the geometry as it would be uploaded, identical meshes under different names match
+            uint64_t computeContentHash() const;
+
+        private:
+            void loadObj(const std::string &filepath);
+            bool loadMeshCache(const std::string &filepath, const std::string &sourcePath, bool optimizeMesh);
+            void saveMeshCache(const std::string &filepath) const;
         };
 
-        Model(Device &device, const Model::Builder &builder);
+        Model(GeometryPool &geometryPool, const Model::Builder &builder);
+        // Adopts geometry the builder was already uploaded to, e.g. by a batched upload
+        Model(GeometryPool &geometryPool, const Model::Builder &builder, const GeometryAllocation &allocation);
         ~Model();
 
         Model(const Model &) = delete;
         Model &operator=(const Model &) = delete;
 
-        static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &modelname);
+        static std::unique_ptr<Model> createModelFromFile(GeometryPool &geometryPool, const std::string &modelname, bool optimizeMesh = true);
 
+        // Binds the pool buffers; draw loops over many models bind the pool once instead
         void bind(VkCommandBuffer commandBuffer);
-        void draw(VkCommandBuffer commandBuffer);
+        void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+
+        // Coarsest level whose error, scaled to the screen by screenSizePerUnit, stays within maxScreenError
+        uint32_t selectLod(float screenSizePerUnit, float maxScreenError) const;
+        uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+        const Lod &getLod(uint32_t lod) const { return lods[lod]; }
+        uint32_t getTriangleCount(uint32_t lod = 0) const;
+        const glm::vec3 &getBoundingCenter() const { return boundingCenter; }
+        float getBoundingRadius() const { return boundingRadius; }
+
+        uint32_t getVertexCount() const { return vertexCount; }
+        uint32_t getIndexCount() const { return indexCount; }
+        VkIndexType getIndexType() const { return indexType; }
+        VkDeviceSize getIndexBufferSize() const { return indexBufferSize; }
+        int32_t getVertexOffset() const { return vertexOffset; }
+        uint32_t getFirstIndex() const { return firstIndex; }
+
+        bool hasMeshlets() const { return meshletCount > 0; }
+        uint32_t getMeshletCount() const { return meshletCount; }
+        // offset of this model's meshlets in the pool meshlet buffer, Lod::firstMeshlet is relative to it
+        uint32_t getFirstMeshlet() const { return firstMeshlet; }
+
+        uint64_t getContentHash() const { return contentHash; }
+        // Pool memory held by the vertices, indices and meshlets of this model
+        VkDeviceSize getResidentBytes() const;
 
     private:
-        void createVertexBuffers(const std::vector<Vertex> &vertices);
-        void createIndexBuffers(const std::vector<uint32_t> &indeces);
+        void computeBounds(const std::vector<Vertex> &vertices);
+
+        GeometryPool &geometryPool;
+        uint64_t contentHash = 0;
+
+        int32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
 
-        Device &device;
+        bool hasIndexBuffer = false;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        VkDeviceSize indexBufferSize = 0;
+        std::vector<IndexRange> chunks;
+        std::vector<Lod> lods;
 
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        uint32_t vertexCount;
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
 
-        bool hasIndexBuffer;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
-        uint32_t indexCount;
+        glm::vec3 boundingCenter{0.0f};
+        float boundingRadius = 0.0f;
     };
 }
\ No newline at end of file
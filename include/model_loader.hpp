@@ -0,0 +1,79 @@
+#pragma once
+
+#include "model.hpp"
+#include "geometry_pool.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hex
+{
+    // Loads models in the background: files are parsed and optimized on worker threads, finished builders are
+    // uploaded in one batched transfer per frame and handed out once the GPU copy has completed, so the render
+    // loop never waits on disk, parsing or uploads
+    class ModelLoader
+    {
+    public:
+        // staging memory one frame's batch may use, a single larger model still goes alone
+        static constexpr VkDeviceSize MAX_BATCH_BYTES = 64ull << 20;
+
+        using Callback = std::function<void(std::shared_ptr<Model>)>;
+
+        explicit ModelLoader(GeometryPool &geometryPool, uint32_t workerCount = 0);
+        ~ModelLoader();
+
+        ModelLoader(const ModelLoader &) = delete;
+        ModelLoader &operator=(const ModelLoader &) = delete;
+
+        // Queues the model and returns immediately; the future is ready, and onLoaded has been called on the main
+        // thread, once the model is resident. Load errors are rethrown by the future
+        std::shared_future<std::shared_ptr<Model>> loadModel(const std::string &modelname, Callback onLoaded = nullptr, bool optimizeMesh = true);
+
+        // Uploads parsed models and publishes finished uploads, call once per frame from the main thread
+        void update();
+
+        bool isIdle() const;
+        uint32_t getPendingCount() const;
+
+    private:
+        struct Request
+        {
+            std::string modelname;
+            bool optimizeMesh;
+            Callback onLoaded;
+            std::promise<std::shared_ptr<Model>> promise;
+            std::unique_ptr<Model::Builder> builder;
+            std::exception_ptr error;
+        };
+
+        struct PendingUpload
+        {
+            GeometryPool::UploadBatch batch;
+            std::vector<std::unique_ptr<Request>> requests;
+            std::vector<GeometryAllocation> allocations;
+        };
+
+        void workerLoop();
+        void submitParsed();
+        void publish(PendingUpload &upload);
+
+        GeometryPool &geometryPool;
+
+        mutable std::mutex mutex;
+        std::condition_variable workAvailable;
+        std::deque<std::unique_ptr<Request>> queued;
+        std::deque<std::unique_ptr<Request>> parsed;
+        uint32_t parsing = 0;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+
+        std::vector<PendingUpload> uploads;
+    };
+}
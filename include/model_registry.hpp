@@ -0,0 +1,76 @@
+#pragma once
+
+#include "model.hpp"
+#include "model_loader.hpp"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hex
+{
+    // Hands out one resident copy of every model: loads are deduplicated by name and, once parsed, by content
+    // hash so the same mesh under two names shares its geometry. Models nobody but the registry references are
+    // evicted, least recently acquired first, whenever the resident geometry exceeds the budget
+    class ModelRegistry
+    {
+    public:
+        static constexpr VkDeviceSize DEFAULT_BUDGET_BYTES = 256ull << 20;
+
+        struct Stats
+        {
+            uint32_t requests = 0;
+            // acquired while already resident or loading
+            uint32_t hits = 0;
+            // loaded under a new name but identical to a resident model
+            uint32_t contentHits = 0;
+            uint32_t misses = 0;
+            uint32_t residentModels = 0;
+            VkDeviceSize residentBytes = 0;
+            uint32_t evictions = 0;
+            VkDeviceSize evictedBytes = 0;
+        };
+
+        explicit ModelRegistry(ModelLoader &modelLoader, VkDeviceSize budgetBytes = DEFAULT_BUDGET_BYTES);
+
+        ModelRegistry(const ModelRegistry &) = delete;
+        ModelRegistry &operator=(const ModelRegistry &) = delete;
+
+        // Starts loading the model unless it is resident or already on its way. onLoaded runs on the main
+        // thread, right away when the model is resident. Holding the model, not the future, keeps it resident
+        std::shared_future<std::shared_ptr<Model>> acquire(const std::string &modelname, ModelLoader::Callback onLoaded = nullptr, bool optimizeMesh = true);
+
+        // Publishes finished loads and evicts over budget, call once per frame after ModelLoader::update
+        void update();
+
+        bool isIdle() const;
+        void setBudget(VkDeviceSize bytes) { budgetBytes = bytes; }
+        VkDeviceSize getBudget() const { return budgetBytes; }
+        const Stats &getStats() const { return stats; }
+
+    private:
+        struct Entry
+        {
+            // the loader's future until the load has been resolved against the resident models
+            std::shared_future<std::shared_ptr<Model>> loading;
+            std::promise<std::shared_ptr<Model>> promise;
+            std::shared_future<std::shared_ptr<Model>> model;
+            std::vector<ModelLoader::Callback> waiting;
+            uint64_t lastUsed = 0;
+        };
+
+        void resolve(Entry &entry, std::shared_ptr<Model> model);
+        void evict();
+
+        ModelLoader &modelLoader;
+        VkDeviceSize budgetBytes;
+
+        std::unordered_map<std::string, Entry> entries;
+        std::unordered_map<uint64_t, std::weak_ptr<Model>> contents;
+        uint64_t frame = 0;
+        Stats stats{};
+    };
+}
@@ -2,11 +2,45 @@
 
 #include "device.hpp"
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace hex
 {
+    // Values for one stage's constant_id constants, baked into the pipeline when it is created so the driver can
+    // fold the branches they select. GLSL bools are 32 bits wide, set them as VkBool32
+    struct SpecializationConstants
+    {
+        std::vector<VkSpecializationMapEntry> entries;
+        std::vector<uint8_t> data;
+
+        template <typename T>
+        void set(uint32_t constantId, const T &value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "specialization constants must be plain values");
+            for (const auto &entry : entries)
+            {
+                if (entry.constantID == constantId && entry.size == sizeof(T))
+                {
+                    std::memcpy(data.data() + entry.offset, &value, sizeof(T));
+                    return;
+                }
+            }
+
+            VkSpecializationMapEntry entry{};
+            entry.constantID = constantId;
+            entry.offset = static_cast<uint32_t>(data.size());
+            entry.size = sizeof(T);
+            entries.push_back(entry);
+            data.resize(data.size() + sizeof(T));
+            std::memcpy(data.data() + entry.offset, &value, sizeof(T));
+        }
+
+        bool empty() const { return entries.empty(); }
+    };
 
     struct PipelineConfigInfo
     {
@@ -22,30 +56,49 @@ namespace hex
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        SpecializationConstants vertSpecialization;
+        SpecializationConstants fragSpecialization;
     };
 
     class Pipeline
     {
     public:
+        // Everything a VkGraphicsPipelineCreateInfo points to besides the config, so several can be filled in
+        // and created in one call. Points into itself, must not move once prepared
+        struct GraphicsCreateState
+        {
+            VkPipelineShaderStageCreateInfo shaderStages[2];
+            VkSpecializationInfo specializationInfos[2];
+            std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+            std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+            VkGraphicsPipelineCreateInfo createInfo;
+        };
+
         Pipeline(Device &device, const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config);
+        Pipeline(Device &device, const std::string &compShaderName, VkPipelineLayout pipelineLayout);
+        // Takes ownership of a pipeline created elsewhere, e.g. in a batch
+        Pipeline(Device &device, VkPipeline pipeline, VkPipelineBindPoint bindPoint);
         ~Pipeline();
 
         Pipeline(const Pipeline &) = delete;
         Pipeline &operator=(const Pipeline &) = delete;
 
         void bind(VkCommandBuffer commandBuffer);
+        VkPipeline getPipeline() const { return pipeline; }
         static void defaultPipelineConigInfo(PipelineConfigInfo &config);
+        // The Model::Vertex attributes the vertex shader reads, so unread ones are never fetched. Throws when it
+        // reads a location the vertex buffer does not provide
+        static std::vector<VkVertexInputAttributeDescription> selectVertexAttributes(const ShaderReflection &vertReflection);
+        // Fills state.createInfo from config and the device's shader modules; config must outlive the creation
+        static void prepareGraphicsPipeline(Device &device, const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config, GraphicsCreateState &state);
 
     private:
-        static std::vector<char> readShader(const std::string &shaderName);
-
         void createGraphicsPipeline(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config);
-
-        void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
+        void createComputePipeline(const std::string &compShaderName, VkPipelineLayout pipelineLayout);
 
         Device &device;
-        VkPipeline graphicsPipeline;
-        VkShaderModule vertShaderModule;
-        VkShaderModule fragShaderModule;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     };
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "descriptors.hpp"
+#include "device.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hex
+{
+    // Hands out shared pipelines and pipeline layouts, creating each distinct one once. Graphics pipelines are
+    // keyed by the fixed function state, the shader modules, the vertex layout, the pipeline layout and the
+    // render pass and subpass they are used in. Everything goes through one VkPipelineCache, which worker
+    // threads share to compile pipelines in the background
+    class PipelineManager
+    {
+    public:
+        using PipelineFuture = std::shared_future<std::shared_ptr<Pipeline>>;
+
+        struct GraphicsPipelineRequest
+        {
+            std::string vertShaderName;
+            std::string fragShaderName;
+            const PipelineConfigInfo *config = nullptr;
+        };
+
+        // Pipeline layout generated from the shaders' reflection, along with what users of it need to know
+        struct ReflectedLayout
+        {
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            // indexed by set number, owned by the manager unless passed in as external sets
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            VkShaderStageFlags pushConstantStages = 0;
+            uint32_t pushConstantSize = 0;
+        };
+
+        // Everything a pipeline or pipeline layout is created from, flattened to bytes. The hash only picks the
+        // bucket, a hit is confirmed by comparing the whole state. Handles in it stand for their objects: shader
+        // modules live as long as the device, layouts as long as the manager, and render passes must outlive
+        // the pipelines created for them
+        struct PipelineKey
+        {
+            std::vector<unsigned char> bytes;
+            size_t hash = 0;
+
+            template <typename... T>
+            void append(const T &...values)
+            {
+                static_assert((std::is_trivially_copyable_v<T> && ...), "keys are compared bytewise");
+                (appendBytes(&values, sizeof(T)), ...);
+            }
+            void appendBytes(const void *data, size_t size);
+            // hashes the bytes, call once everything is appended
+            void seal();
+
+            bool operator==(const PipelineKey &other) const { return hash == other.hash && bytes == other.bytes; }
+        };
+
+        struct PipelineKeyHash
+        {
+            size_t operator()(const PipelineKey &key) const { return key.hash; }
+        };
+
+        struct Stats
+        {
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            uint32_t batches = 0;
+            uint32_t asyncCompiles = 0;
+            // spent in the driver creating pipelines, summed over all threads
+            float compileMilliseconds = 0.0f;
+        };
+
+        explicit PipelineManager(Device &device, uint32_t workerCount = 0);
+        ~PipelineManager();
+
+        PipelineManager(const PipelineManager &) = delete;
+        PipelineManager &operator=(const PipelineManager &) = delete;
+
+        // Identical set layouts and push constant ranges get the same layout, so pipelines built on them can match
+        VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts, const std::vector<VkPushConstantRange> &pushConstantRanges);
+        // Identical bindings get the same set layout
+        VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+        DescriptorLayoutCache &getDescriptorLayoutCache() { return descriptorLayoutCache; }
+        // Merges the descriptor bindings and push constant blocks of the stages into one layout. Buffers listed in
+        // dynamicBuffers, by set and binding, become their dynamic offset variants. externalSets replace what the
+        // shaders declare for those set numbers, for layouts reflection cannot describe such as bindless tables.
+        // Throws when the stages disagree about a binding
+        ReflectedLayout getReflectedPipelineLayout(const std::vector<std::string> &shaderNames, const std::vector<std::pair<uint32_t, uint32_t>> &dynamicBuffers = {},
+                                                   const std::vector<std::pair<uint32_t, VkDescriptorSetLayout>> &externalSets = {});
+
+        std::shared_ptr<Pipeline> getGraphicsPipeline(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config);
+        // Creates every pipeline missing from the cache in a single vkCreateGraphicsPipelines call
+        std::vector<std::shared_ptr<Pipeline>> getGraphicsPipelines(const std::vector<GraphicsPipelineRequest> &requests);
+        std::shared_ptr<Pipeline> getComputePipeline(const std::string &compShaderName, VkPipelineLayout pipelineLayout);
+        // Compiles the pipeline on a worker thread and returns at once; the future is already ready when the
+        // pipeline is cached. Callers keep drawing with a fallback pipeline until it is. config is copied and
+        // must point at its own colorBlendAttachment and dynamicStateEnables
+        PipelineFuture getGraphicsPipelineAsync(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config);
+
+        Stats getStats() const;
+
+        static PipelineKey graphicsPipelineKey(Device &device, const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config);
+
+    private:
+        struct CompileJob
+        {
+            PipelineKey key;
+            std::string vertShaderName;
+            std::string fragShaderName;
+            PipelineConfigInfo config;
+            std::promise<std::shared_ptr<Pipeline>> promise;
+        };
+
+        void workerLoop();
+
+        Device &device;
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        DescriptorLayoutCache descriptorLayoutCache;
+
+        // guards everything below, pipelines are created outside of it
+        mutable std::mutex mutex;
+        std::unordered_map<PipelineKey, std::shared_ptr<Pipeline>, PipelineKeyHash> pipelines;
+        std::unordered_map<PipelineKey, VkPipelineLayout, PipelineKeyHash> pipelineLayouts;
+        std::unordered_map<PipelineKey, PipelineFuture, PipelineKeyHash> pending;
+        Stats stats{};
+
+        std::condition_variable workAvailable;
+        std::deque<std::unique_ptr<CompileJob>> jobs;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+    };
+}
@@ -37,6 +37,8 @@ namespace hex
         }
 
         VkCommandBuffer beginFrame();
+        // Makes this frame's submission wait for work signaled on another queue, e.g. async compute
+        void waitBeforeRendering(VkSemaphore semaphore, VkPipelineStageFlags stage);
         void endFrame();
         void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
@@ -50,9 +52,17 @@ namespace hex
         Device &device;
         std::unique_ptr<SwapChain> swapChain;
         std::vector<VkCommandBuffer> commandBuffers;
+        std::vector<VkSemaphore> extraWaitSemaphores;
+        std::vector<VkPipelineStageFlags> extraWaitStages;
+
+        // HEX_RESIZE_STATS=1 prints how long each recreation held up the frame
+        bool logResizeStats = false;
+        uint32_t resizeCount = 0;
+        float resizeTotalMilliseconds = 0.0f;
+        float resizeMaxMilliseconds = 0.0f;
 
         uint32_t currentImageIndex;
-        int currentFrameIndex;
-        bool isFrameStarted;
+        int currentFrameIndex = 0;
+        bool isFrameStarted = false;
     };
 }
\ No newline at end of file
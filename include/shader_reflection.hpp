@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hex
+{
+    // Resource interface of a SPIR-V module, read straight from its instructions: descriptor bindings, the push
+    // constant block and, for vertex shaders, the input locations. Needs no debug names, so it works on stripped
+    // binaries too
+    struct ShaderReflection
+    {
+        struct DescriptorBinding
+        {
+            uint32_t set;
+            uint32_t binding;
+            VkDescriptorType descriptorType;
+            // 0 for runtime sized arrays
+            uint32_t descriptorCount;
+        };
+
+        struct VertexInput
+        {
+            uint32_t location;
+            VkFormat format;
+        };
+
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+        // sorted by set, then binding
+        std::vector<DescriptorBinding> descriptorBindings;
+        // sorted by location, empty for all but vertex shaders
+        std::vector<VertexInput> vertexInputs;
+        // bytes of the push constant block used by the stage, size 0 without one
+        uint32_t pushConstantOffset = 0;
+        uint32_t pushConstantSize = 0;
+
+        // Throws on anything that is not a well formed SPIR-V module
+        static ShaderReflection reflect(const void *code, size_t size);
+    };
+}
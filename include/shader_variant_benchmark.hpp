@@ -0,0 +1,45 @@
+#pragma once
+
+#include "gpu_timer.hpp"
+#include "simple_render_system.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace hex
+{
+    // Switches the render system through every shader variant in turn and prints the average GPU time of the
+    // frames drawn with each one, as measured by a GpuTimer around the render pass
+    class ShaderVariantBenchmark
+    {
+    public:
+        explicit ShaderVariantBenchmark(uint32_t framesPerVariant);
+
+        // Once per frame before recording; starts with the first variant and moves on once enough frames of the
+        // current one have been timed
+        void update(SimpleRenderSystem &renderSystem, const GpuTimer &gpuTimer);
+        bool isFinished() const { return variant >= VARIANTS.size(); }
+
+    private:
+        using ShaderVariant = SimpleRenderSystem::ShaderVariant;
+        using LightingModel = SimpleRenderSystem::LightingModel;
+
+        static constexpr std::array<ShaderVariant, 5> VARIANTS{{
+            {LightingModel::Unlit, true, false},
+            {LightingModel::Unlit, false, false},
+            {LightingModel::PerVertex, true, false},
+            {LightingModel::PerFragment, true, false},
+            {LightingModel::PerFragment, false, false},
+        }};
+
+        void startVariant(SimpleRenderSystem &renderSystem);
+
+        uint32_t framesPerVariant;
+        size_t variant = 0;
+        bool started = false;
+        uint32_t skip = 0;
+        uint32_t samples = 0;
+        double milliseconds = 0.0;
+    };
+}
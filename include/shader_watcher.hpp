@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hex
+{
+    // Development mode shader reloading. A background thread watches the GLSL sources with inotify and
+    // recompiles each changed stage with glslc into shaders/<name>.spv; the render loop picks the finished ones
+    // up with takeCompiled at a frame boundary. Failed compiles leave the previous binary in place. Only
+    // available on Linux, elsewhere the watcher stays inactive
+    class ShaderWatcher
+    {
+    public:
+        ShaderWatcher(const std::string &sourceDirectory, const std::string &outputDirectory = "shaders");
+        ~ShaderWatcher();
+
+        ShaderWatcher(const ShaderWatcher &) = delete;
+        ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+        bool isActive() const { return watchDescriptor >= 0; }
+
+        // Names, e.g. simple.frag, of the shaders recompiled since the last call
+        std::vector<std::string> takeCompiled();
+
+        static bool isShaderSource(const std::string &filename);
+
+    private:
+        void watchLoop();
+        bool compile(const std::string &name);
+
+        std::string sourceDirectory;
+        std::string outputDirectory;
+        int inotifyDescriptor = -1;
+        int watchDescriptor = -1;
+
+        std::atomic<bool> stopping{false};
+        std::thread watcher;
+
+        std::mutex mutex;
+        std::vector<std::string> compiled;
+    };
+}
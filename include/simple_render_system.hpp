@@ -4,29 +4,109 @@
 #include "device.hpp"
 #include "game_object.hpp"
 #include "camera.hpp"
+#include "frame_info.hpp"
+#include "frame_buffer_ring.hpp"
 
+#include <future>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace hex
 {
+    class MeshletCullingSystem;
+    class GeometryPool;
+    class PipelineManager;
+    class DescriptorAllocator;
+    class BindlessTable;
+
     class SimpleRenderSystem
     {
     public:
-        SimpleRenderSystem(Device &device, VkRenderPass renderPass);
-        ~SimpleRenderSystem();
+        // highest geometric error, in normalized device units, a level of detail may show on screen
+        static constexpr float LOD_SCREEN_ERROR = 0.004f;
+        // objects drawn per frame, the rest are skipped
+        static constexpr uint32_t MAX_OBJECTS = 16384;
+
+        // Must match LIGHTING_MODEL in simple.vert and simple.frag
+        enum class LightingModel : int32_t
+        {
+            Unlit = 0,
+            PerVertex = 1,
+            PerFragment = 2
+        };
+
+        // Everything that selects a pipeline variant. Lighting and vertex colors are specialization constants,
+        // so every variant runs only the shader code it needs
+        struct ShaderVariant
+        {
+            LightingModel lighting = LightingModel::Unlit;
+            bool vertexColor = true;
+            bool wireframe = false;
+        };
+
+        struct RenderStats
+        {
+            uint32_t drawCalls = 0;
+            uint32_t bufferBinds = 0;
+            uint32_t triangles = 0;
+        };
+
+        // The frame set comes from descriptorAllocator, which must never be reset while the system lives. With a
+        // bindless table objects are textured through it, without one they draw in their vertex colors
+        SimpleRenderSystem(Device &device, GeometryPool &geometryPool, PipelineManager &pipelineManager, DescriptorAllocator &descriptorAllocator, VkRenderPass renderPass,
+                           const BindlessTable *bindlessTable = nullptr);
 
         SimpleRenderSystem(const SimpleRenderSystem &) = delete;
         SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-        void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject> &gameObjects, const Camera &camera);
+        // Objects culled by meshletCulling this frame are drawn from its indirect commands, the rest directly
+        void renderGameObjects(FrameInfo &frameInfo, std::vector<GameObject> &gameObjects, const MeshletCullingSystem *meshletCulling = nullptr);
+
+        // Level of detail whose projected error stays below LOD_SCREEN_ERROR
+        static uint32_t selectLod(const GameObject &gameObject, const glm::mat4 &modelMatrix, const Camera &camera);
+
+        const RenderStats &getStats() const { return stats; }
+
+        // Switches to another pipeline variant. It compiles in the background while the current one keeps
+        // drawing, so switching never stalls a frame
+        void setShaderVariant(const ShaderVariant &variant);
+        const ShaderVariant &getShaderVariant() const { return requestedVariant; }
+        // True until the last requested variant is the one drawing
+        bool isVariantPending() const { return pendingPipeline.valid(); }
+        void setWireframe(bool enabled);
+        bool isWireframeSupported() const;
+        // Recompiles the current variant from the current shader modules, e.g. after a hot reload
+        void reloadPipeline() { setShaderVariant(requestedVariant); }
+
+        static const char *getLightingModelName(LightingModel lighting);
 
     private:
         void createPipelineLayout();
-        void createPipeline(VkRenderPass renderPass);
+        void createFrameData();
+        void createPipeline();
+        void configurePipeline(PipelineConfigInfo &config, const ShaderVariant &variant) const;
 
         Device &device;
-        std::unique_ptr<Pipeline> pipeline;
+        GeometryPool &geometryPool;
+        PipelineManager &pipelineManager;
+        DescriptorAllocator &descriptorAllocator;
+        // both owned by the pipeline manager
+        std::shared_ptr<Pipeline> pipeline;
         VkPipelineLayout pipelineLayout;
+        VkShaderStageFlags pushConstantStages = 0;
+        VkRenderPass renderPass;
+        const BindlessTable *bindlessTable;
+        std::string fragShaderName;
+        // replaces pipeline once compiled
+        std::shared_future<std::shared_ptr<Pipeline>> pendingPipeline;
+        ShaderVariant requestedVariant{};
+
+        // camera and per object data of every frame in flight, found through dynamic offsets into one set
+        std::unique_ptr<FrameBufferRing> frameData;
+        VkDescriptorSetLayout frameSetLayout;
+        VkDescriptorSet frameDescriptorSet;
+        bool objectLimitReported = false;
+        RenderStats stats{};
     };
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vulkan/vulkan.h>
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -18,13 +19,17 @@ namespace hex
         static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
         SwapChain(Device &deviceRef, VkExtent2D windowExtent);
+        // Takes over what the previous swapchain has that does not depend on the extent: its render pass when the
+        // formats match, its per frame semaphores and GPU timeline, and its depth memory where the new images fit.
+        // Keeps the previous one alive until its presents are done
         SwapChain(Device &deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
         ~SwapChain();
 
         SwapChain(const SwapChain &) = delete;
         SwapChain &operator=(const SwapChain &) = delete;
 
-        VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+        // Depth attachments belong to frame slots rather than images, so there is a framebuffer per pair
+        VkFramebuffer getFrameBuffer(int frameIndex, int imageIndex) { return swapChainFramebuffers[frameIndex * imageCount() + imageIndex]; }
         VkRenderPass getRenderPass() { return renderPass; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
         size_t imageCount() { return swapChainImages.size(); }
@@ -40,20 +45,37 @@ namespace hex
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t *imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+        // extraWaitSemaphores, each with the stage in extraWaitStages, come on top of the acquired image
+        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex,
+                                      const std::vector<VkSemaphore> &extraWaitSemaphores = {}, const std::vector<VkPipelineStageFlags> &extraWaitStages = {});
         bool compareSwapFormats(const SwapChain &swapChain) const
         {
             return swapChainImageFormat == swapChain.swapChainImageFormat && swapChainDepthFormat == swapChain.swapChainDepthFormat;
         };
 
+        // What was taken over from the previous swapchain
+        bool keptRenderPass() const { return renderPassKept; }
+        uint32_t reusedDepthMemoryCount() const { return depthMemoryReused; }
+        // Depth is cleared on load and never stored, so tile based GPUs can keep it on chip without backing memory
+        bool isDepthLazilyAllocated() const { return depthLazilyAllocated; }
+
+        // Prints the depth attachment memory of one device local image per swapchain image against one
+        // transient image per frame in flight, at a few common resolutions
+        static void reportDepthMemory(Device &device);
     private:
-        void init();
+        void init(SwapChain *previous);
         void createSwapChain();
         void createImageViews();
-        void createDepthResources();
+        void createDepthResources(SwapChain *previous);
         void createRenderPass();
         void createFramebuffers();
-        void createSyncObjects();
+        void createSyncObjects(SwapChain *previous);
+        // present fences, only with capabilities.swapchainMaintenance1
+        VkFence acquirePresentFence();
+        void recyclePresentFences();
+        bool presentsComplete();
+        // once per present, drops the previous swapchains whose presents are done
+        void releaseRetiredSwapChains();
 
         // Helper functions
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -72,6 +94,9 @@ namespace hex
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
+        // size and type of each depth allocation, for later swapchains to bind their depth images to
+        std::vector<VkDeviceSize> depthMemorySizes;
+        std::vector<uint32_t> depthMemoryTypes;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
@@ -83,9 +108,25 @@ namespace hex
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        std::vector<VkFence> imagesInFlight;
+        // last submission of each frame slot and of each image, waited on before either is reused
+        std::vector<TimelinePoint> framesInFlight;
+        std::vector<TimelinePoint> imagesInFlight;
         size_t currentFrame = 0;
+
+        // signaled once the presentation engine is done with the image and the semaphore of a present
+        std::vector<VkFence> pendingPresentFences;
+        std::vector<VkFence> freePresentFences;
+        struct RetiredSwapChain
+        {
+            std::shared_ptr<SwapChain> swapChain;
+            // presents of ours left before it goes when there are no present fences to tell
+            size_t framesLeft;
+        };
+        std::vector<RetiredSwapChain> retiredSwapChains;
+
+        bool renderPassKept = false;
+        bool depthLazilyAllocated = false;
+        uint32_t depthMemoryReused = 0;
     };
 
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 
 namespace hex
@@ -10,4 +12,15 @@ namespace hex
         seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         (hashCombine(seed, rest), ...);
     };
+
+    // FNV-1a, for content addressing whole buffers; pass the previous result as seed to hash several in a row
+    inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+    {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            seed = (seed ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return seed;
+    }
 }
\ No newline at end of file
@@ -1,13 +1,20 @@
 #version 450
 
+// must match simple.vert
+layout(constant_id = 0) const int LIGHTING_MODEL = 0;
+
 layout(location = 0) out vec4 color;
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
 
-layout(push_constant) uniform Push{
-    mat4 transform;
-    vec3 color;
-} push;
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.1;
 
 void main() {
-    color = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    if (LIGHTING_MODEL == 2) {
+        float lightIntensity = AMBIENT + max(dot(normalize(fragNormal), DIRECTION_TO_LIGHT), 0.0);
+        color = vec4(fragColor * lightIntensity, 1.0);
+    } else {
+        color = vec4(fragColor, 1.0);
+    }
+}
@@ -1,16 +1,63 @@
 #version 450
 
+// set per pipeline, branches on them are folded away when the pipeline is created
+// 0 unlit, 1 lit per vertex, 2 lit per fragment
+layout(constant_id = 0) const int LIGHTING_MODEL = 0;
+// false draws every model in plain white, e.g. for meshes without vertex colors
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = true;
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+// only read by simple_bindless.frag
+layout(location = 2) out vec2 fragUv;
+layout(location = 3) flat out uint fragObjectIndex;
+
+// bound with a dynamic offset to the current frame's data
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 projectionView;
+    vec4 time;
+} ubo;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    // indices into the bindless arrays
+    uint textureIndex;
+    uint samplerIndex;
+    uvec2 padding;
+};
 
-layout(push_constant) uniform Push{
-    mat4 transform;
-    vec3 color;
+layout(set = 0, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform Push {
+    uint objectIndex;
 } push;
 
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.1;
+
 void main() {
-    gl_Position = push.transform * vec4(position, 1.0);
-    fragColor = color;
-}
\ No newline at end of file
+    ObjectData object = objects[push.objectIndex];
+    gl_Position = ubo.projectionView * (object.model * vec4(position, 1.0));
+
+    vec3 baseColor = USE_VERTEX_COLOR ? color : vec3(1.0);
+    vec3 normalWorldSpace = normalize(mat3(object.normalMatrix) * normal);
+    if (LIGHTING_MODEL == 1) {
+        float lightIntensity = AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0.0);
+        fragColor = baseColor * lightIntensity;
+    } else {
+        fragColor = baseColor;
+    }
+    fragNormal = normalWorldSpace;
+    fragUv = uv;
+    fragObjectIndex = push.objectIndex;
+}
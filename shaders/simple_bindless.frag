@@ -0,0 +1,44 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// simple.frag reading each object's texture from the bindless table, for devices with descriptor indexing
+
+// must match simple.vert
+layout(constant_id = 0) const int LIGHTING_MODEL = 0;
+
+layout(location = 0) out vec4 color;
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragUv;
+layout(location = 3) flat in uint fragObjectIndex;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    uint textureIndex;
+    uint samplerIndex;
+    uvec2 padding;
+};
+
+layout(set = 0, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// BindlessTable, the layout comes from there rather than from reflection
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.1;
+
+void main() {
+    ObjectData object = objects[fragObjectIndex];
+    vec3 albedo = fragColor * texture(sampler2D(textures[nonuniformEXT(object.textureIndex)], samplers[nonuniformEXT(object.samplerIndex)]), fragUv).rgb;
+
+    if (LIGHTING_MODEL == 2) {
+        float lightIntensity = AMBIENT + max(dot(normalize(fragNormal), DIRECTION_TO_LIGHT), 0.0);
+        color = vec4(albedo * lightIntensity, 1.0);
+    } else {
+        color = vec4(albedo, 1.0);
+    }
+}
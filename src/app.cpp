@@ -1,19 +1,61 @@
 #include "app.hpp"
 
 #include <stdexcept>
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
 #include <glm/gtc/constants.hpp>
 #include "simple_render_system.hpp"
+#include "file_view.hpp"
+#include "gpu_timer.hpp"
+#include "bindless_table.hpp"
+#include "shader_watcher.hpp"
+#include "shader_variant_benchmark.hpp"
+#include "meshlet_culling_system.hpp"
 #include "camera.hpp"
 #include "movement_controller.hpp"
 
+// set by the build to the directory holding the GLSL sources
+#ifndef HEX_SHADER_SOURCE_DIR
+#define HEX_SHADER_SOURCE_DIR "shaders"
+#endif
+
 #define MAX_FRAME_TIME 1.0f / 60.0f
+#define STATS_INTERVAL 1.0f
 
 namespace hex
 {
     App::App()
     {
+        // HEX_IO_BENCHMARK=<file> compares the file read paths before anything else touches the disk
+        if (const char *benchmarkFile = std::getenv("HEX_IO_BENCHMARK"))
+        {
+            FileView::benchmark(benchmarkFile);
+        }
+        // HEX_DESCRIPTOR_BENCHMARK=<sets> compares per frame descriptor set allocation strategies
+        if (const char *descriptorBenchmark = std::getenv("HEX_DESCRIPTOR_BENCHMARK"))
+        {
+            DescriptorAllocator::benchmark(device, pipelineManager.getDescriptorLayoutCache(), static_cast<uint32_t>(std::max(1, std::atoi(descriptorBenchmark))));
+        }
+
+        // HEX_DEPTH_MEMORY_REPORT=1 prints what the depth attachments cost at common resolutions
+        if (const char *depthReport = std::getenv("HEX_DEPTH_MEMORY_REPORT"))
+        {
+            if (std::string{depthReport} != "0")
+            {
+                SwapChain::reportDepthMemory(device);
+            }
+        }
+
+        for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            frameDescriptorAllocators.push_back(std::make_unique<DescriptorAllocator>(device));
+        }
+
+        startTime = std::chrono::high_resolution_clock::now();
         loadGameObjects();
     }
 
@@ -21,14 +63,63 @@ namespace hex
 
     void App::run()
     {
-        SimpleRenderSystem simpleRenderSystem{device, renderer.getSwapChainRenderPass()};
+        // HEX_BINDLESS=0 forces the path devices without descriptor indexing take
+        const char *bindless = std::getenv("HEX_BINDLESS");
+        std::unique_ptr<BindlessTable> bindlessTable;
+        if (BindlessTable::isSupported(device) && !(bindless && std::atoi(bindless) == 0))
+        {
+            bindlessTable = std::make_unique<BindlessTable>(device);
+        }
+
+        SimpleRenderSystem simpleRenderSystem{device, geometryPool, pipelineManager, descriptorAllocator, renderer.getSwapChainRenderPass(), bindlessTable.get()};
+        std::unique_ptr<MeshletCullingSystem> meshletCullingSystem;
+        if (MeshletCullingSystem::isSupported(device))
+        {
+            meshletCullingSystem = std::make_unique<MeshletCullingSystem>(device, geometryPool, pipelineManager, descriptorAllocator);
+        }
         Camera camera{};
 
+        // HEX_SHADER_BENCHMARK=<frames> times the render pass of every shader variant over that many frames
+        // once all models are resident
+        std::unique_ptr<GpuTimer> gpuTimer;
+        std::unique_ptr<ShaderVariantBenchmark> shaderBenchmark;
+        if (const char *benchmarkFrames = std::getenv("HEX_SHADER_BENCHMARK"))
+        {
+            if (GpuTimer::isSupported(device))
+            {
+                gpuTimer = std::make_unique<GpuTimer>(device);
+                shaderBenchmark = std::make_unique<ShaderVariantBenchmark>(static_cast<uint32_t>(std::max(1, std::atoi(benchmarkFrames))));
+            }
+            else
+            {
+                std::cout << "shader benchmark: no timestamp support on the graphics queue" << std::endl;
+            }
+        }
+
+        // HEX_SHADER_HOT_RELOAD=<directory> recompiles GLSL saved there while running, the source tree's shaders
+        // when left empty
+        std::unique_ptr<ShaderWatcher> shaderWatcher;
+        if (const char *hotReload = std::getenv("HEX_SHADER_HOT_RELOAD"))
+        {
+            shaderWatcher = std::make_unique<ShaderWatcher>(*hotReload ? hotReload : HEX_SHADER_SOURCE_DIR);
+        }
+
         auto viewerObject = GameObject::createGameObject();
         MovementController cameraController{window.getGLFWwindow(), viewerObject};
 
         auto currentTime = std::chrono::high_resolution_clock::now();
 
+        float statsTime = 0.0f;
+        uint32_t statsFrames = 0;
+        uint64_t statsTriangles = 0;
+        uint64_t statsMeshlets = 0;
+        uint64_t statsVisibleMeshlets = 0;
+        bool wireframe = false;
+        bool wireframeKeyDown = false;
+        bool lightingKeyDown = false;
+        bool firstFrame = true;
+        bool allResident = false;
+
         while (!window.shouldClose())
         {
             glfwPollEvents();
@@ -36,8 +127,87 @@ namespace hex
             auto newTime = std::chrono::high_resolution_clock::now();
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
+
+            statsTime += frameTime;
+            if (statsTime >= STATS_INTERVAL && statsFrames > 0)
+            {
+                std::cout << "frame stats: " << statsFrames / statsTime << " fps, " << statsTriangles / statsFrames << " triangles/frame, "
+                          << statsVisibleMeshlets / statsFrames << "/" << statsMeshlets / statsFrames << " meshlets visible" << std::endl;
+                statsTime = 0.0f;
+                statsFrames = 0;
+                statsTriangles = 0;
+                statsMeshlets = 0;
+                statsVisibleMeshlets = 0;
+            }
+
             frameTime = glm::min(frameTime, MAX_FRAME_TIME);
 
+            modelLoader.update();
+            modelRegistry.update();
+            // unshared loads go to the loader directly, the registry does not see them
+            if (!allResident && modelRegistry.isIdle() && modelLoader.isIdle())
+            {
+                allResident = true;
+                const auto &registryStats = modelRegistry.getStats();
+                std::cout << "all " << gameObjects.size() << " objects resident after "
+                          << std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count()
+                          << " ms" << std::endl;
+                std::cout << "model registry: " << registryStats.requests << " requests, " << registryStats.hits << " hits, "
+                          << registryStats.contentHits << " content hits, " << registryStats.misses << " misses, "
+                          << registryStats.residentModels << " models resident in " << registryStats.residentBytes << " bytes, "
+                          << registryStats.evictions << " evictions (" << registryStats.evictedBytes << " bytes)" << std::endl;
+            }
+
+            // F toggles wireframe, the filled pipeline keeps drawing until the wireframe one has compiled
+            bool wireframeKey = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F) == GLFW_PRESS;
+            if (wireframeKey && !wireframeKeyDown && simpleRenderSystem.isWireframeSupported())
+            {
+                wireframe = !wireframe;
+                simpleRenderSystem.setWireframe(wireframe);
+            }
+            wireframeKeyDown = wireframeKey;
+
+            // L cycles through the lighting models
+            bool lightingKey = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_L) == GLFW_PRESS;
+            if (lightingKey && !lightingKeyDown)
+            {
+                SimpleRenderSystem::ShaderVariant variant = simpleRenderSystem.getShaderVariant();
+                variant.lighting = static_cast<SimpleRenderSystem::LightingModel>((static_cast<int32_t>(variant.lighting) + 1) % 3);
+                simpleRenderSystem.setShaderVariant(variant);
+                std::cout << "lighting: " << SimpleRenderSystem::getLightingModelName(variant.lighting) << std::endl;
+            }
+            lightingKeyDown = lightingKey;
+
+            if (shaderBenchmark && allResident)
+            {
+                shaderBenchmark->update(simpleRenderSystem, *gpuTimer);
+            }
+
+            if (shaderWatcher)
+            {
+                // new pipelines are requested between frames, the old ones stay alive for the frames in flight
+                bool reloaded = false;
+                for (const auto &name : shaderWatcher->takeCompiled())
+                {
+                    try
+                    {
+                        reloaded |= device.reloadShaderModule(name);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::cerr << "shader " << name << " not reloaded: " << e.what() << std::endl;
+                    }
+                }
+                if (reloaded)
+                {
+                    simpleRenderSystem.reloadPipeline();
+                    if (meshletCullingSystem)
+                    {
+                        meshletCullingSystem->reloadPipeline();
+                    }
+                }
+            }
+
             cameraController.moveInPlaneXZ(frameTime);
             cameraController.lookAround(frameTime);
             camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
@@ -47,17 +217,63 @@ namespace hex
 
             if (auto commandBuffer = renderer.beginFrame())
             {
+                // the timeline passed this slot's last submission, nothing reads the sets allocated when this slot last ran
+                DescriptorAllocator &frameDescriptors = *frameDescriptorAllocators[renderer.getFrameIndex()];
+                frameDescriptors.reset();
+
+                if (meshletCullingSystem)
+                {
+                    VkSemaphore cullFinished = meshletCullingSystem->cull(commandBuffer, renderer.getFrameIndex(), gameObjects, camera);
+                    if (cullFinished != VK_NULL_HANDLE)
+                    {
+                        renderer.waitBeforeRendering(cullFinished, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+                    }
+                }
+
+                if (gpuTimer)
+                {
+                    gpuTimer->begin(commandBuffer, renderer.getFrameIndex());
+                }
                 renderer.beginSwapChainRenderPass(commandBuffer);
-                simpleRenderSystem.renderGameObjects(commandBuffer, gameObjects, camera);
+                float time = std::chrono::duration<float, std::chrono::seconds::period>(newTime - startTime).count();
+                FrameInfo frameInfo{renderer.getFrameIndex(), time, commandBuffer, camera, frameDescriptors};
+                simpleRenderSystem.renderGameObjects(frameInfo, gameObjects, meshletCullingSystem.get());
                 renderer.endSwapChainRenderPass(commandBuffer);
+                if (gpuTimer)
+                {
+                    gpuTimer->end(commandBuffer, renderer.getFrameIndex());
+                }
                 renderer.endFrame();
+
+                if (firstFrame)
+                {
+                    firstFrame = false;
+                    size_t resident = std::count_if(gameObjects.begin(), gameObjects.end(), [](const GameObject &gameObject)
+                                                    { return gameObject.model != nullptr; });
+                    std::cout << "time to first frame: "
+                              << std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count()
+                              << " ms, " << resident << "/" << gameObjects.size() << " objects resident" << std::endl;
+                    // compare builds with HEX_OPTIMIZE_SHADERS on and off, the SPIR-V sizes are logged as shaders load
+                    auto pipelineStats = pipelineManager.getStats();
+                    std::cout << "pipelines: " << pipelineStats.misses << " compiled in " << pipelineStats.compileMilliseconds << " ms" << std::endl;
+                }
+
+                statsFrames++;
+                statsTriangles += simpleRenderSystem.getStats().triangles;
+                if (meshletCullingSystem)
+                {
+                    // lags MAX_FRAMES_IN_FLIGHT frames behind, read back once the GPU is done with the slot
+                    statsTriangles += meshletCullingSystem->getStats().visibleTriangles;
+                    statsMeshlets += meshletCullingSystem->getStats().meshlets;
+                    statsVisibleMeshlets += meshletCullingSystem->getStats().visibleMeshlets;
+                }
             }
         }
 
         vkDeviceWaitIdle(device.device());
     }
 
-    std::unique_ptr<Model> createTestCubeModel(Device &device, glm::vec3 offset)
+    std::unique_ptr<Model> createTestCubeModel(GeometryPool &geometryPool, glm::vec3 offset)
     {
         Model::Builder modelBuilder{};
         modelBuilder.vertices = {
@@ -80,19 +296,60 @@ namespace hex
             4, 0, 5, 1, 5, 0,
             3, 2, 7, 6, 2, 7};
 
-        return std::make_unique<Model>(device, modelBuilder);
+        return std::make_unique<Model>(geometryPool, modelBuilder);
     }
 
-    void App::loadGameObjects()
+    void App::spawnGameObject(const std::string &modelname, const TransformComponent &transform, bool shared)
     {
-        // std::shared_ptr<Model> model = createTestCubeModel(device, {0.0f, 0.0f, 0.0f});
-        std::shared_ptr<Model> model = Model::createModelFromFile(device, "colored_cube");
+        auto gameObject = GameObject::createGameObject();
+        gameObject.transform = transform;
+        GameObject::id_t id = gameObject.getId();
+        gameObjects.push_back(std::move(gameObject));
 
-        auto obj = GameObject::createGameObject();
-        obj.model = model;
-        obj.transform.translation = {0.0f, 0.0f, 2.5f};
-        obj.transform.scale = {1.0f, 1.0f, 1.0f};
+        // game objects may have moved around in the vector by the time the model arrives
+        auto onLoaded = [this, id](std::shared_ptr<Model> model)
+        {
+            for (auto &gameObject : gameObjects)
+            {
+                if (gameObject.getId() == id)
+                {
+                    gameObject.model = std::move(model);
+                    break;
+                }
+            }
+        };
 
-        gameObjects.push_back(std::move(obj));
+        if (shared)
+        {
+            modelRegistry.acquire(modelname, onLoaded);
+        }
+        else
+        {
+            modelLoader.loadModel(modelname, onLoaded);
+        }
+    }
+
+    void App::loadGameObjects()
+    {
+        // std::shared_ptr<Model> model = createTestCubeModel(geometryPool, {0.0f, 0.0f, 0.0f});
+        spawnGameObject("colored_cube", {{0.0f, 0.0f, 2.5f}, {1.0f, 1.0f, 1.0f}});
+        spawnGameObject("smooth_vase", {{-1.5f, 0.5f, 2.5f}, {3.0f, 1.5f, 3.0f}});
+        spawnGameObject("flat_vase", {{1.5f, 0.5f, 2.5f}, {3.0f, 1.5f, 3.0f}});
+
+        // HEX_LOAD_TEST=<count> streams in a grid of that many extra vases, each loaded and uploaded on its own.
+        // HEX_LOAD_TEST_SHARED=<count> adds the same grid through the registry, all sharing the two vase models
+        const char *loadTest = std::getenv("HEX_LOAD_TEST");
+        const char *sharedLoadTest = std::getenv("HEX_LOAD_TEST_SHARED");
+        if (loadTest || sharedLoadTest)
+        {
+            bool shared = loadTest == nullptr;
+            int count = std::atoi(shared ? sharedLoadTest : loadTest);
+            int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+            for (int i = 0; i < count; i++)
+            {
+                glm::vec3 translation{(i % side - side * 0.5f) * 1.5f, 0.5f, 5.0f + (i / side) * 1.5f};
+                spawnGameObject(i % 2 ? "flat_vase" : "smooth_vase", {translation, {3.0f, 1.5f, 3.0f}}, shared);
+            }
+        }
     }
-}
\ No newline at end of file
+}
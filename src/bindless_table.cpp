@@ -0,0 +1,265 @@
+#include "bindless_table.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace hex
+{
+    bool BindlessTable::isSupported(Device &device)
+    {
+        return device.capabilities.descriptorIndexing;
+    }
+
+    BindlessTable::BindlessTable(Device &device) : device{device}
+    {
+        if (!isSupported(device))
+        {
+            throw std::runtime_error("bindless resources need descriptor indexing");
+        }
+
+        const auto &limits = device.descriptorIndexingProperties;
+        slots[SAMPLED_IMAGES].capacity = std::min({MAX_SAMPLED_IMAGES, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+        slots[SAMPLERS].capacity = std::min({MAX_SAMPLERS, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+        slots[STORAGE_BUFFERS].capacity = std::min({MAX_STORAGE_BUFFERS, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+        createSetLayout();
+        createDescriptorSet();
+        createDefaultResources();
+
+        std::cout << "bindless: " << slots[SAMPLED_IMAGES].capacity << " images, " << slots[SAMPLERS].capacity << " samplers, "
+                  << slots[STORAGE_BUFFERS].capacity << " storage buffers" << std::endl;
+    }
+
+    BindlessTable::~BindlessTable()
+    {
+        vkDestroySampler(device.device(), defaultSampler, nullptr);
+        vkDestroyImageView(device.device(), defaultImageView, nullptr);
+        vkDestroyImage(device.device(), defaultImage, nullptr);
+        vkFreeMemory(device.device(), defaultImageMemory, nullptr);
+        vkDestroyBuffer(device.device(), defaultBuffer, nullptr);
+        vkFreeMemory(device.device(), defaultBufferMemory, nullptr);
+        vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device.device(), setLayout, nullptr);
+    }
+
+    static const std::array<VkDescriptorType, BindlessTable::BINDING_COUNT> DESCRIPTOR_TYPES = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    };
+
+    void BindlessTable::createSetLayout()
+    {
+        std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings{};
+        std::array<VkDescriptorBindingFlags, BINDING_COUNT> bindingFlags{};
+        for (uint32_t i = 0; i < BINDING_COUNT; i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = DESCRIPTOR_TYPES[i];
+            bindings[i].descriptorCount = slots[i].capacity;
+            bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        flagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless descriptor set layout");
+        }
+    }
+
+    void BindlessTable::createDescriptorSet()
+    {
+        std::array<VkDescriptorPoolSize, BINDING_COUNT> poolSizes{};
+        for (uint32_t i = 0; i < BINDING_COUNT; i++)
+        {
+            poolSizes[i].type = DESCRIPTOR_TYPES[i];
+            poolSizes[i].descriptorCount = slots[i].capacity;
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless descriptor pool");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+
+        if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate bindless descriptor set");
+        }
+    }
+
+    void BindlessTable::createDefaultResources()
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageInfo.extent = {1, 1, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, defaultImage, defaultImageMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = defaultImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &defaultImageView) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless default image view");
+        }
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &defaultSampler) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless default sampler");
+        }
+
+        device.createBuffer(16, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, defaultBuffer, defaultBufferMemory);
+
+        // clears need no staging, the texel and the buffer are filled on the GPU
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = defaultImage;
+        barrier.subresourceRange = viewInfo.subresourceRange;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkClearColorValue white{};
+        white.float32[0] = white.float32[1] = white.float32[2] = white.float32[3] = 1.0f;
+        vkCmdClearColorImage(commandBuffer, defaultImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &viewInfo.subresourceRange);
+        vkCmdFillBuffer(commandBuffer, defaultBuffer, 0, VK_WHOLE_SIZE, 0);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &bufferBarrier, 0, nullptr, 1, &barrier);
+
+        device.endSingleTimeCommands(commandBuffer);
+
+        // land in DEFAULT_INDEX, the first slot handed out
+        addSampledImage(defaultImageView);
+        addSampler(defaultSampler);
+        addStorageBuffer(defaultBuffer);
+    }
+
+    uint32_t BindlessTable::acquireSlot(Binding binding)
+    {
+        Slots &table = slots[binding];
+        if (!table.freed.empty())
+        {
+            uint32_t index = table.freed.back();
+            table.freed.pop_back();
+            return index;
+        }
+        if (table.next == table.capacity)
+        {
+            throw std::runtime_error("bindless table full, binding " + std::to_string(binding) + " holds " + std::to_string(table.capacity));
+        }
+        return table.next++;
+    }
+
+    void BindlessTable::write(Binding binding, uint32_t index, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo)
+    {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = binding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = DESCRIPTOR_TYPES[binding];
+        write.pImageInfo = imageInfo;
+        write.pBufferInfo = bufferInfo;
+        vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+    }
+
+    uint32_t BindlessTable::addSampledImage(VkImageView imageView, VkImageLayout imageLayout)
+    {
+        uint32_t index = acquireSlot(SAMPLED_IMAGES);
+        VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, imageView, imageLayout};
+        write(SAMPLED_IMAGES, index, &imageInfo, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessTable::addSampler(VkSampler sampler)
+    {
+        uint32_t index = acquireSlot(SAMPLERS);
+        VkDescriptorImageInfo imageInfo{sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+        write(SAMPLERS, index, &imageInfo, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessTable::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        uint32_t index = acquireSlot(STORAGE_BUFFERS);
+        VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+        write(STORAGE_BUFFERS, index, nullptr, &bufferInfo);
+        return index;
+    }
+
+    void BindlessTable::remove(Binding binding, uint32_t index)
+    {
+        if (index == DEFAULT_INDEX || index >= slots[binding].next)
+        {
+            return;
+        }
+        // partially bound, the stale descriptor stays until the slot is written again and is never read meanwhile
+        slots[binding].freed.push_back(index);
+    }
+}
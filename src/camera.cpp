@@ -29,6 +29,13 @@ namespace hex
         projectionMatrix[3][2] = -(far * near) / (far - near);
     }
 
+    float Camera::projectedScreenSize(float worldSize, float viewDepth) const
+    {
+        float scale = glm::abs(projectionMatrix[1][1]);
+        bool perspective = projectionMatrix[2][3] != 0.0f;
+        return perspective ? worldSize * scale / viewDepth : worldSize * scale;
+    }
+
     void Camera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up)
     {
         const glm::vec3 w{glm::normalize(direction)};
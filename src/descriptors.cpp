@@ -0,0 +1,284 @@
+#include "descriptors.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace hex
+{
+    DescriptorLayoutCache::DescriptorLayoutCache(Device &device) : device{device}
+    {
+    }
+
+    DescriptorLayoutCache::~DescriptorLayoutCache()
+    {
+        for (auto &[hash, cached] : layouts)
+        {
+            vkDestroyDescriptorSetLayout(device.device(), cached.layout, nullptr);
+        }
+    }
+
+    VkDescriptorSetLayout DescriptorLayoutCache::getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+    {
+        std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+                  { return a.binding < b.binding; });
+
+        size_t hash = 0;
+        for (const auto &binding : bindings)
+        {
+            hashCombine(hash, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags);
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        auto [first, last] = layouts.equal_range(hash);
+        for (auto cached = first; cached != last; ++cached)
+        {
+            if (std::equal(bindings.begin(), bindings.end(), cached->second.bindings.begin(), cached->second.bindings.end(),
+                           [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+                           { return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags; }))
+            {
+                return cached->second.layout;
+            }
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor set layout");
+        }
+        layouts.emplace(hash, CachedLayout{std::move(bindings), layout});
+        return layout;
+    }
+
+    const std::vector<DescriptorAllocator::PoolRatio> DescriptorAllocator::DEFAULT_RATIOS = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f},
+    };
+
+    DescriptorAllocator::DescriptorAllocator(Device &device, uint32_t setsPerPool, std::vector<PoolRatio> ratios)
+        : device{device}, ratios{std::move(ratios)}, setsPerPool{std::max(1u, setsPerPool)}
+    {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator()
+    {
+        reset();
+        for (auto pool : freePools)
+        {
+            vkDestroyDescriptorPool(device.device(), pool, nullptr);
+        }
+    }
+
+    VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto &ratio : ratios)
+        {
+            poolSizes.push_back({ratio.type, std::max(1u, static_cast<uint32_t>(ratio.perSet * setCount))});
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = setCount;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor pool");
+        }
+        return pool;
+    }
+
+    VkDescriptorPool DescriptorAllocator::grabPool()
+    {
+        if (!freePools.empty())
+        {
+            VkDescriptorPool pool = freePools.back();
+            freePools.pop_back();
+            return pool;
+        }
+
+        VkDescriptorPool pool = createPool(setsPerPool);
+        // a frame that needed more pools will likely need them again, grow so it needs fewer next time
+        setsPerPool = std::min(MAX_SETS_PER_POOL, setsPerPool * 2);
+        return pool;
+    }
+
+    VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+    {
+        if (currentPool == VK_NULL_HANDLE)
+        {
+            currentPool = grabPool();
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        allocInfo.descriptorPool = currentPool;
+
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(device.device(), &allocInfo, &set);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+        {
+            fullPools.push_back(currentPool);
+            currentPool = grabPool();
+            allocInfo.descriptorPool = currentPool;
+            result = vkAllocateDescriptorSets(device.device(), &allocInfo, &set);
+        }
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate descriptor set");
+        }
+        return set;
+    }
+
+    void DescriptorAllocator::reset()
+    {
+        if (currentPool != VK_NULL_HANDLE)
+        {
+            fullPools.push_back(currentPool);
+            currentPool = VK_NULL_HANDLE;
+        }
+        for (auto pool : fullPools)
+        {
+            vkResetDescriptorPool(device.device(), pool, 0);
+            freePools.push_back(pool);
+        }
+        fullPools.clear();
+    }
+
+    void DescriptorAllocator::benchmark(Device &device, DescriptorLayoutCache &layoutCache, uint32_t setsPerFrame, uint32_t frames)
+    {
+        // the shape of a typical per draw set
+        std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        VkDescriptorSetLayout layout = layoutCache.getLayout(bindings);
+
+        auto elapsedMicroseconds = [](std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<float, std::chrono::microseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+
+        // naive: one pool big enough for a frame, every set allocated and freed on its own
+        std::vector<VkDescriptorPoolSize> poolSizes = {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setsPerFrame}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setsPerFrame}};
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.maxSets = setsPerFrame;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        VkDescriptorPool naivePool;
+        if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &naivePool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor pool");
+        }
+
+        std::vector<VkDescriptorSet> sets(setsPerFrame);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = naivePool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &layout;
+            for (auto &set : sets)
+            {
+                if (vkAllocateDescriptorSets(device.device(), &allocInfo, &set) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to allocate descriptor set");
+                }
+            }
+            for (auto &set : sets)
+            {
+                vkFreeDescriptorSets(device.device(), naivePool, 1, &set);
+            }
+        }
+        float naiveMicroseconds = elapsedMicroseconds(start) / frames;
+        vkDestroyDescriptorPool(device.device(), naivePool, nullptr);
+
+        // the allocator, warmed up so pool creation is not measured
+        DescriptorAllocator allocator{device};
+        for (auto &set : sets)
+        {
+            set = allocator.allocate(layout);
+        }
+        allocator.reset();
+
+        start = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            for (auto &set : sets)
+            {
+                set = allocator.allocate(layout);
+            }
+            allocator.reset();
+        }
+        float allocatorMicroseconds = elapsedMicroseconds(start) / frames;
+
+        std::cout << "descriptor benchmark, " << setsPerFrame << " sets/frame: allocate and free " << naiveMicroseconds << " us/frame, pool allocator with reset "
+                  << allocatorMicroseconds << " us/frame" << std::endl;
+    }
+
+    DescriptorWriter &DescriptorWriter::writeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        bufferInfos.push_back({buffer, offset, range});
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        write.pBufferInfo = &bufferInfos.back();
+        writes.push_back(write);
+        return *this;
+    }
+
+    DescriptorWriter &DescriptorWriter::writeImage(uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout)
+    {
+        imageInfos.push_back({sampler, imageView, imageLayout});
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        write.pImageInfo = &imageInfos.back();
+        writes.push_back(write);
+        return *this;
+    }
+
+    void DescriptorWriter::update(Device &device, VkDescriptorSet set)
+    {
+        for (auto &write : writes)
+        {
+            write.dstSet = set;
+        }
+        vkUpdateDescriptorSets(device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
@@ -1,10 +1,18 @@
 #include "device.hpp"
+#include "embedded_shaders.hpp"
+#include "file_view.hpp"
+#include "utils.hpp"
 
 // std headers
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <optional>
 #include <set>
 #include <unordered_set>
+#include <utility>
 
 namespace hex
 {
@@ -63,11 +71,22 @@ namespace hex
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPool();
+        createTimelines();
     }
 
     Device::~Device()
     {
+        destroyTimelines();
+        destroyShaderModules();
         vkDestroyCommandPool(device_, commandPool, nullptr);
+        if (transferCommandPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+        }
+        if (computeCommandPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(device_, computeCommandPool, nullptr);
+        }
         vkDestroyDevice(device_, nullptr);
 
         if (enableValidationLayers)
@@ -92,13 +111,38 @@ namespace hex
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // the newest version the engine knows, capped by the loader; loaders without vkEnumerateInstanceVersion
+        // only know 1.0. Devices may still support less, see negotiateFeatures
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        uint32_t loaderVersion = VK_API_VERSION_1_0;
+        if (enumerateInstanceVersion != nullptr)
+        {
+            enumerateInstanceVersion(&loaderVersion);
+        }
+        instanceApiVersion = std::min(VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(loaderVersion), VK_API_VERSION_MINOR(loaderVersion), 0), VK_API_VERSION_1_3);
+        appInfo.apiVersion = instanceApiVersion;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         createInfo.pApplicationInfo = &appInfo;
 
         auto extensions = getRequiredExtensions();
+        // lists portability drivers such as MoltenVK, which the loader hides from apps that do not ask for them
+        if (hasInstanceExtension(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
+        {
+            extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+            createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+        }
+#ifdef VK_EXT_swapchain_maintenance1
+        // instance side of swapchain maintenance1, see negotiateExtensions
+        surfaceMaintenance1 = hasInstanceExtension(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+                              hasInstanceExtension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        if (surfaceMaintenance1)
+        {
+            extensions.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        }
+#endif
         createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -125,6 +169,98 @@ namespace hex
         hasGflwRequiredInstanceExtensions();
     }
 
+    static const char *physicalDeviceTypeName(VkPhysicalDeviceType type)
+    {
+        switch (type)
+        {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return "cpu";
+        default:
+            return "other";
+        }
+    }
+
+    static std::string toLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    uint64_t Device::scorePhysicalDevice(VkPhysicalDevice device)
+    {
+        if (!isDeviceSuitable(device))
+        {
+            return 0;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        // the type decides, memory and the rest only order devices of the same type
+        uint64_t typeRank = 0;
+        switch (deviceProperties.deviceType)
+        {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            typeRank = 4;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            typeRank = 3;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            typeRank = 2;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            typeRank = 1;
+            break;
+        default:
+            break;
+        }
+        uint64_t score = 1 + typeRank * 1'000'000'000'000ull;
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+        VkDeviceSize deviceLocalBytes = 0;
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            {
+                deviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+            }
+        }
+        score += std::min<uint64_t>(deviceLocalBytes / (1024 * 1024), 10'000'000) * 1000;
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        bool graphicsCompute = false;
+        bool asyncCompute = false;
+        bool dedicatedTransfer = false;
+        for (const auto &family : queueFamilies)
+        {
+            bool graphics = family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+            bool compute = family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+            graphicsCompute |= graphics && compute;
+            asyncCompute |= !graphics && compute;
+            dedicatedTransfer |= !graphics && !compute && (family.queueFlags & VK_QUEUE_TRANSFER_BIT);
+        }
+        // meshlet culling runs on the graphics queue, the others let uploads and compute overlap rendering
+        score += graphicsCompute ? 400 : 0;
+        score += asyncCompute ? 200 : 0;
+        score += dedicatedTransfer ? 100 : 0;
+
+        uint32_t apiVersion = std::min(instanceApiVersion, deviceProperties.apiVersion);
+        score += apiVersion >= VK_API_VERSION_1_3 ? 50 : apiVersion >= VK_API_VERSION_1_2 ? 25 : 0;
+        return score;
+    }
+
     void Device::pickPhysicalDevice()
     {
         uint32_t deviceCount = 0;
@@ -137,21 +273,71 @@ namespace hex
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-        for (const auto &device : devices)
+        struct Candidate
+        {
+            uint32_t index;
+            VkPhysicalDevice device;
+            VkPhysicalDeviceProperties properties;
+            uint64_t score;
+        };
+        std::vector<Candidate> candidates;
+        for (uint32_t i = 0; i < deviceCount; i++)
         {
-            if (isDeviceSuitable(device))
+            Candidate candidate{i, devices[i], {}, scorePhysicalDevice(devices[i])};
+            vkGetPhysicalDeviceProperties(devices[i], &candidate.properties);
+            candidates.push_back(candidate);
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                         { return a.score > b.score; });
+
+        const Candidate *selected = candidates.front().score > 0 ? &candidates.front() : nullptr;
+
+        // HEX_GPU=<index> picks by enumeration order, anything else by a case insensitive part of the name
+        if (const char *requested = std::getenv("HEX_GPU"))
+        {
+            std::string request = toLower(requested);
+            bool byIndex = !request.empty() && std::all_of(request.begin(), request.end(), [](unsigned char c)
+                                                           { return std::isdigit(c); });
+            unsigned long requestedIndex = byIndex ? std::strtoul(requested, nullptr, 10) : 0;
+            auto match = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate &candidate)
+                                      { return byIndex ? candidate.index == requestedIndex
+                                                       : toLower(candidate.properties.deviceName).find(request) != std::string::npos; });
+            if (match == candidates.end())
             {
-                physicalDevice = device;
-                break;
+                std::cerr << "HEX_GPU=" << requested << " matches no device, using the best ranked" << std::endl;
+            }
+            else if (match->score == 0)
+            {
+                std::cerr << "HEX_GPU=" << requested << " matches " << match->properties.deviceName << ", which is not suitable, using the best ranked" << std::endl;
+            }
+            else
+            {
+                selected = &*match;
             }
         }
 
-        if (physicalDevice == VK_NULL_HANDLE)
+        std::cout << "device ranking:" << std::endl;
+        for (const auto &candidate : candidates)
         {
-            throw std::runtime_error("failed to find a suitable GPU!");
+            std::cout << "\t" << (&candidate == selected ? "* " : "  ") << "[" << candidate.index << "] " << candidate.properties.deviceName
+                      << " (" << physicalDeviceTypeName(candidate.properties.deviceType) << ", vulkan " << VK_API_VERSION_MAJOR(candidate.properties.apiVersion)
+                      << "." << VK_API_VERSION_MINOR(candidate.properties.apiVersion) << ") ";
+            if (candidate.score > 0)
+            {
+                std::cout << "score " << candidate.score << std::endl;
+            }
+            else
+            {
+                std::cout << "unsuitable" << std::endl;
+            }
         }
 
-        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (selected == nullptr)
+        {
+            throw std::runtime_error("failed to find a suitable GPU!");
+        }
+        physicalDevice = selected->device;
+        properties = selected->properties;
         std::cout << "physical device: " << properties.deviceName << std::endl;
     }
 
@@ -161,6 +347,23 @@ namespace hex
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        // HEX_ASYNC_QUEUES=0 keeps everything on the graphics queue, to compare against
+        const char *asyncQueues = std::getenv("HEX_ASYNC_QUEUES");
+        if (asyncQueues != nullptr && std::string{asyncQueues} == "0")
+        {
+            indices.transferFamilyHasValue = false;
+            indices.computeFamilyHasValue = false;
+        }
+        capabilities.dedicatedTransferQueue = indices.transferFamilyHasValue;
+        capabilities.asyncComputeQueue = indices.computeFamilyHasValue;
+        if (indices.transferFamilyHasValue)
+        {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
+        if (indices.computeFamilyHasValue)
+        {
+            uniqueQueueFamilies.insert(indices.computeFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -173,8 +376,10 @@ namespace hex
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        VkPhysicalDeviceFeatures deviceFeatures = {};
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
+        FeatureChain enabled{};
+        negotiateFeatures(enabled);
+        std::vector<const char *> extensions = negotiateExtensions(enabled);
+        logCapabilities();
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -182,9 +387,17 @@ namespace hex
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // features 2 and its chain need 1.1, 1.0 takes the plain struct
+        if (capabilities.apiVersion >= VK_API_VERSION_1_1)
+        {
+            createInfo.pNext = &enabled.features;
+        }
+        else
+        {
+            createInfo.pEnabledFeatures = &enabled.features.features;
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -203,13 +416,230 @@ namespace hex
             throw std::runtime_error("failed to create logical device!");
         }
 
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        graphicsQueueFlags = queueFamilies[indices.graphicsFamily].queueFlags;
+        graphicsQueueTimestampBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        if (indices.transferFamilyHasValue)
+        {
+            vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+        }
+        if (indices.computeFamilyHasValue)
+        {
+            vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+        }
+        selectedQueueFamilies = indices;
+        std::cout << "queues: graphics family " << indices.graphicsFamily;
+        if (indices.transferFamilyHasValue)
+        {
+            std::cout << ", transfer family " << indices.transferFamily;
+        }
+        if (indices.computeFamilyHasValue)
+        {
+            std::cout << ", async compute family " << indices.computeFamily;
+        }
+        std::cout << std::endl;
+    }
+
+    void Device::negotiateFeatures(FeatureChain &enabled)
+    {
+        // what the device supports under the version the instance asked for
+        capabilities.apiVersion = std::min(instanceApiVersion, properties.apiVersion);
+
+        FeatureChain supported{};
+        supported.features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.vulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        supported.vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        supported.vulkan13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        enabled.features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        enabled.vulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        enabled.vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        enabled.vulkan13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+        // the per version structs may only be chained once the device reports that version
+        if (capabilities.apiVersion >= VK_API_VERSION_1_2)
+        {
+            supported.features.pNext = &supported.vulkan11;
+            supported.vulkan11.pNext = &supported.vulkan12;
+            enabled.features.pNext = &enabled.vulkan11;
+            enabled.vulkan11.pNext = &enabled.vulkan12;
+        }
+        if (capabilities.apiVersion >= VK_API_VERSION_1_3)
+        {
+            supported.vulkan12.pNext = &supported.vulkan13;
+            enabled.vulkan12.pNext = &enabled.vulkan13;
+        }
+
+        if (capabilities.apiVersion >= VK_API_VERSION_1_1)
+        {
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supported.features);
+        }
+        else
+        {
+            vkGetPhysicalDeviceFeatures(physicalDevice, &supported.features.features);
+        }
+
+        // only what some system uses, everything else stays off
+        VkPhysicalDeviceFeatures &core = enabled.features.features;
+        core.samplerAnisotropy = VK_TRUE;
+        core.multiDrawIndirect = supported.features.features.multiDrawIndirect;
+        core.fillModeNonSolid = supported.features.features.fillModeNonSolid;
+        capabilities.multiDrawIndirect = core.multiDrawIndirect;
+        capabilities.fillModeNonSolid = core.fillModeNonSolid;
+
+        if (capabilities.apiVersion >= VK_API_VERSION_1_2)
+        {
+            enabled.vulkan11.shaderDrawParameters = supported.vulkan11.shaderDrawParameters;
+            capabilities.shaderDrawParameters = enabled.vulkan11.shaderDrawParameters;
+
+            const VkPhysicalDeviceVulkan12Features &vulkan12 = supported.vulkan12;
+            // all or nothing, a bindless table needs every one of them
+            capabilities.descriptorIndexing = vulkan12.runtimeDescriptorArray && vulkan12.descriptorBindingPartiallyBound &&
+                                              vulkan12.descriptorBindingSampledImageUpdateAfterBind && vulkan12.descriptorBindingStorageBufferUpdateAfterBind &&
+                                              vulkan12.shaderSampledImageArrayNonUniformIndexing;
+            if (capabilities.descriptorIndexing)
+            {
+                enabled.vulkan12.runtimeDescriptorArray = VK_TRUE;
+                enabled.vulkan12.descriptorBindingPartiallyBound = VK_TRUE;
+                enabled.vulkan12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                enabled.vulkan12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                enabled.vulkan12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            }
+            enabled.vulkan12.timelineSemaphore = vulkan12.timelineSemaphore;
+            enabled.vulkan12.drawIndirectCount = vulkan12.drawIndirectCount;
+            enabled.vulkan12.hostQueryReset = vulkan12.hostQueryReset;
+            capabilities.timelineSemaphore = vulkan12.timelineSemaphore;
+            capabilities.drawIndirectCount = vulkan12.drawIndirectCount;
+            capabilities.hostQueryReset = vulkan12.hostQueryReset;
+        }
+
+        if (capabilities.apiVersion >= VK_API_VERSION_1_3)
+        {
+            enabled.vulkan13.synchronization2 = supported.vulkan13.synchronization2;
+            enabled.vulkan13.dynamicRendering = supported.vulkan13.dynamicRendering;
+            enabled.vulkan13.maintenance4 = supported.vulkan13.maintenance4;
+            capabilities.synchronization2 = supported.vulkan13.synchronization2;
+            capabilities.dynamicRendering = supported.vulkan13.dynamicRendering;
+            capabilities.maintenance4 = supported.vulkan13.maintenance4;
+        }
+
+        if (capabilities.descriptorIndexing)
+        {
+            descriptorIndexingProperties = {};
+            descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties2 = {};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &descriptorIndexingProperties;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        }
+    }
+
+    std::vector<const char *> Device::negotiateExtensions(FeatureChain &enabled)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        std::unordered_set<std::string> available;
+        for (const auto &extension : availableExtensions)
+        {
+            available.insert(extension.extensionName);
+        }
+
+        // isDeviceSuitable already made sure the required ones are there
+        std::vector<const char *> extensions = deviceExtensions;
+        for (const char *extension : optionalDeviceExtensions)
+        {
+            if (available.count(extension) > 0)
+            {
+                extensions.push_back(extension);
+            }
+        }
+        capabilities.portabilitySubset = available.count(PORTABILITY_SUBSET_EXTENSION_NAME) > 0;
+
+#ifdef VK_EXT_swapchain_maintenance1
+        // present fences; the feature is queried through features 2 and chained in front of the enabled ones
+        if (surfaceMaintenance1 && capabilities.apiVersion >= VK_API_VERSION_1_1 &&
+            available.count(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME) > 0)
+        {
+            VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT supported{};
+            supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+            VkPhysicalDeviceFeatures2 features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &supported;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+            if (supported.swapchainMaintenance1)
+            {
+                enabled.swapchainMaintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+                enabled.swapchainMaintenance1.swapchainMaintenance1 = VK_TRUE;
+                enabled.swapchainMaintenance1.pNext = enabled.features.pNext;
+                enabled.features.pNext = &enabled.swapchainMaintenance1;
+                extensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+                capabilities.swapchainMaintenance1 = true;
+            }
+        }
+#endif
+        return extensions;
+    }
+
+    void Device::logCapabilities() const
+    {
+        std::cout << "vulkan " << VK_API_VERSION_MAJOR(capabilities.apiVersion) << "." << VK_API_VERSION_MINOR(capabilities.apiVersion) << ", enabled:";
+        const std::pair<bool, const char *> flags[] = {
+            {capabilities.multiDrawIndirect, "multi draw indirect"},
+            {capabilities.fillModeNonSolid, "fill mode non solid"},
+            {capabilities.shaderDrawParameters, "shader draw parameters"},
+            {capabilities.descriptorIndexing, "descriptor indexing"},
+            {capabilities.timelineSemaphore, "timeline semaphores"},
+            {capabilities.drawIndirectCount, "draw indirect count"},
+            {capabilities.hostQueryReset, "host query reset"},
+            {capabilities.synchronization2, "synchronization2"},
+            {capabilities.dynamicRendering, "dynamic rendering"},
+            {capabilities.maintenance4, "maintenance4"},
+            {capabilities.portabilitySubset, "portability subset"},
+            {capabilities.swapchainMaintenance1, "swapchain maintenance1"},
+            {capabilities.dedicatedTransferQueue, "dedicated transfer queue"},
+            {capabilities.asyncComputeQueue, "async compute queue"},
+        };
+        const char *separator = " ";
+        for (const auto &[enabled, name] : flags)
+        {
+            if (enabled)
+            {
+                std::cout << separator << name;
+                separator = ", ";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    bool Device::hasInstanceExtension(const char *extensionName)
+    {
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+        for (const auto &extension : extensions)
+        {
+            if (std::strcmp(extension.extensionName, extensionName) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
     void Device::createCommandPool()
     {
-        QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
+        const QueueFamilyIndices &queueFamilyIndices = selectedQueueFamilies;
 
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -221,6 +651,23 @@ namespace hex
         {
             throw std::runtime_error("failed to create command pool!");
         }
+
+        if (queueFamilyIndices.transferFamilyHasValue)
+        {
+            poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+            if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create transfer command pool!");
+            }
+        }
+        if (queueFamilyIndices.computeFamilyHasValue)
+        {
+            poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+            if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create compute command pool!");
+            }
+        }
     }
 
     void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -376,27 +823,51 @@ namespace hex
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-        int i = 0;
-        for (const auto &queueFamily : queueFamilies)
+        for (uint32_t i = 0; i < queueFamilyCount; i++)
         {
-            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            const auto &queueFamily = queueFamilies[i];
+            if (queueFamily.queueCount == 0)
+            {
+                continue;
+            }
+
+            bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+            bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+            if (graphics && !indices.graphicsFamilyHasValue)
             {
                 indices.graphicsFamily = i;
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-            if (queueFamily.queueCount > 0 && presentSupport)
+            if (presentSupport && !indices.presentFamilyHasValue)
             {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
             }
-            if (indices.isComplete())
+
+            // a copy engine: transfer only, runs beside graphics and compute
+            if (!graphics && !compute && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !indices.transferFamilyHasValue)
             {
-                break;
+                indices.transferFamily = i;
+                indices.transferFamilyHasValue = true;
+            }
+            if (!graphics && compute && !indices.computeFamilyHasValue)
+            {
+                indices.computeFamily = i;
+                indices.computeFamilyHasValue = true;
             }
+        }
 
-            i++;
+        // presenting from the graphics family saves an ownership transfer of every swapchain image
+        if (indices.graphicsFamilyHasValue)
+        {
+            VkBool32 graphicsPresents = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, indices.graphicsFamily, surface_, &graphicsPresents);
+            if (graphicsPresents)
+            {
+                indices.presentFamily = indices.graphicsFamily;
+            }
         }
 
         return indices;
@@ -453,6 +924,16 @@ namespace hex
     }
 
     uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        uint32_t typeIndex;
+        if (!tryFindMemoryType(typeFilter, properties, typeIndex))
+        {
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+        return typeIndex;
+    }
+
+    bool Device::tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &typeIndex)
     {
         VkPhysicalDeviceMemoryProperties memProperties;
         vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -461,11 +942,11 @@ namespace hex
             if ((typeFilter & (1 << i)) &&
                 (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
             {
-                return i;
+                typeIndex = i;
+                return true;
             }
         }
-
-        throw std::runtime_error("failed to find suitable memory type!");
+        return false;
     }
 
     void Device::createBuffer(
@@ -473,7 +954,8 @@ namespace hex
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory)
+        VkDeviceMemory &bufferMemory,
+        const std::vector<uint32_t> &concurrentFamilies)
     {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -481,6 +963,16 @@ namespace hex
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+        std::vector<uint32_t> families(concurrentFamilies);
+        std::sort(families.begin(), families.end());
+        families.erase(std::unique(families.begin(), families.end()), families.end());
+        if (families.size() > 1)
+        {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+            bufferInfo.pQueueFamilyIndices = families.data();
+        }
+
         if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create vertex buffer!");
@@ -530,12 +1022,326 @@ namespace hex
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        waitFor(submit(QueueType::Graphics, submitInfo));
 
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
+    void Device::createTimelines()
+    {
+        timelines[static_cast<size_t>(QueueType::Graphics)].queue = graphicsQueue_;
+        timelines[static_cast<size_t>(QueueType::Transfer)].queue = transferQueue_;
+        timelines[static_cast<size_t>(QueueType::Compute)].queue = computeQueue_;
+        if (!capabilities.timelineSemaphore)
+        {
+            return;
+        }
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        for (auto &timeline : timelines)
+        {
+            if (timeline.queue != VK_NULL_HANDLE && vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &timeline.semaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create timeline semaphore!");
+            }
+        }
+    }
+
+    void Device::destroyTimelines()
+    {
+        vkDeviceWaitIdle(device_);
+
+        // the GPU is idle, so every pending reclaim can run whatever its point; retire points one submission
+        // ahead of the last frame would otherwise never be reached. Reclaims may queue further reclaims
+        while (true)
+        {
+            std::vector<std::pair<TimelinePoint, std::function<void()>>> remaining;
+            {
+                std::lock_guard<std::mutex> lock{timelineMutex};
+                remaining.swap(pendingReclaims);
+            }
+            if (remaining.empty())
+            {
+                break;
+            }
+            for (auto &[point, reclaim] : remaining)
+            {
+                reclaim();
+            }
+        }
+
+        for (auto &timeline : timelines)
+        {
+            if (timeline.semaphore != VK_NULL_HANDLE)
+            {
+                vkDestroySemaphore(device_, timeline.semaphore, nullptr);
+            }
+            for (const auto &[value, fence] : timeline.pendingFences)
+            {
+                vkDestroyFence(device_, fence, nullptr);
+            }
+        }
+        for (VkFence fence : fencePool)
+        {
+            vkDestroyFence(device_, fence, nullptr);
+        }
+    }
+
+    TimelinePoint Device::submit(QueueType queue, const VkSubmitInfo &submitInfo)
+    {
+        std::lock_guard<std::mutex> lock{timelineMutex};
+        auto &timeline = timelines[static_cast<size_t>(queue)];
+        if (timeline.queue == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("submitted to a queue the device does not have");
+        }
+
+        uint64_t value = timeline.submittedValue + 1;
+        VkSubmitInfo info = submitInfo;
+        VkFence fence = VK_NULL_HANDLE;
+
+        // binary semaphores ignore their values, but the arrays must cover every semaphore of the submission
+        std::vector<uint64_t> waitValues(info.waitSemaphoreCount, 0);
+        std::vector<VkSemaphore> signalSemaphores(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+        std::vector<uint64_t> signalValues(info.signalSemaphoreCount, 0);
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        if (timeline.semaphore != VK_NULL_HANDLE)
+        {
+            signalSemaphores.push_back(timeline.semaphore);
+            signalValues.push_back(value);
+
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.pNext = info.pNext;
+            timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+            timelineInfo.pWaitSemaphoreValues = waitValues.data();
+            timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+            timelineInfo.pSignalSemaphoreValues = signalValues.data();
+            info.pNext = &timelineInfo;
+            info.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+            info.pSignalSemaphores = signalSemaphores.data();
+        }
+        else if (fencePool.empty())
+        {
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create submission fence!");
+            }
+        }
+        else
+        {
+            fence = fencePool.back();
+            fencePool.pop_back();
+        }
+
+        if (vkQueueSubmit(timeline.queue, 1, &info, fence) != VK_SUCCESS)
+        {
+            if (fence != VK_NULL_HANDLE)
+            {
+                fencePool.push_back(fence);
+            }
+            throw std::runtime_error("failed to submit command buffer!");
+        }
+
+        timeline.submittedValue = value;
+        if (fence != VK_NULL_HANDLE)
+        {
+            timeline.pendingFences.emplace_back(value, fence);
+        }
+
+        TimelinePoint point{};
+        point.values[static_cast<size_t>(queue)] = value;
+        return point;
+    }
+
+    uint64_t Device::pollCompletedValue(QueueTimeline &timeline)
+    {
+        if (timeline.completedValue == timeline.submittedValue)
+        {
+            return timeline.completedValue;
+        }
+
+        if (timeline.semaphore != VK_NULL_HANDLE)
+        {
+            vkGetSemaphoreCounterValue(device_, timeline.semaphore, &timeline.completedValue);
+            return timeline.completedValue;
+        }
+
+        // a queue finishes its submissions in order, so do the fences
+        while (!timeline.pendingFences.empty() && vkGetFenceStatus(device_, timeline.pendingFences.front().second) == VK_SUCCESS)
+        {
+            auto [value, fence] = timeline.pendingFences.front();
+            timeline.pendingFences.pop_front();
+            // a fence waitFor is still waiting on is recycled by its last waiter
+            if (fenceWaiters.count(fence) == 0)
+            {
+                vkResetFences(device_, 1, &fence);
+                fencePool.push_back(fence);
+            }
+            timeline.completedValue = value;
+        }
+        return timeline.completedValue;
+    }
+
+    TimelinePoint Device::getSubmittedPoint()
+    {
+        std::lock_guard<std::mutex> lock{timelineMutex};
+        TimelinePoint point{};
+        for (size_t i = 0; i < TimelinePoint::QUEUE_COUNT; i++)
+        {
+            point.values[i] = timelines[i].submittedValue;
+        }
+        return point;
+    }
+
+    TimelinePoint Device::getRetirePoint()
+    {
+        TimelinePoint point = getSubmittedPoint();
+        point.values[static_cast<size_t>(QueueType::Graphics)]++;
+        return point;
+    }
+
+    bool Device::isComplete(const TimelinePoint &point)
+    {
+        std::lock_guard<std::mutex> lock{timelineMutex};
+        for (size_t i = 0; i < TimelinePoint::QUEUE_COUNT; i++)
+        {
+            if (point.values[i] > timelines[i].completedValue && point.values[i] > pollCompletedValue(timelines[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Device::waitFor(const TimelinePoint &point)
+    {
+        std::vector<VkSemaphore> semaphores;
+        std::vector<uint64_t> values;
+        std::vector<VkFence> fences;
+        {
+            std::lock_guard<std::mutex> lock{timelineMutex};
+            for (size_t i = 0; i < TimelinePoint::QUEUE_COUNT; i++)
+            {
+                auto &timeline = timelines[i];
+                // nothing would ever signal it, and the caller is likely the one who would have to submit it
+                if (point.values[i] > timeline.submittedValue)
+                {
+                    throw std::runtime_error("waited for a submission that was never made");
+                }
+                if (point.values[i] <= timeline.completedValue)
+                {
+                    continue;
+                }
+                if (timeline.semaphore != VK_NULL_HANDLE)
+                {
+                    semaphores.push_back(timeline.semaphore);
+                    values.push_back(point.values[i]);
+                    continue;
+                }
+
+                auto pending = std::find_if(timeline.pendingFences.begin(), timeline.pendingFences.end(), [&](const auto &entry)
+                                            { return entry.first == point.values[i]; });
+                if (pending == timeline.pendingFences.end())
+                {
+                    throw std::runtime_error("no fence for a pending submission");
+                }
+                // keeps pollCompletedValue from resetting and reusing it while it is waited on
+                fenceWaiters[pending->second]++;
+                fences.push_back(pending->second);
+            }
+        }
+
+        // outside the lock, other threads can keep submitting and queueing reclaims meanwhile
+        if (!fences.empty())
+        {
+            vkWaitForFences(device_, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+        }
+        if (!semaphores.empty())
+        {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+            waitInfo.pSemaphores = semaphores.data();
+            waitInfo.pValues = values.data();
+            vkWaitSemaphores(device_, &waitInfo, UINT64_MAX);
+        }
+
+        if (fences.empty() && semaphores.empty())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{timelineMutex};
+        // retires the waited fences from their timelines before the last waiter recycles them
+        for (auto &timeline : timelines)
+        {
+            pollCompletedValue(timeline);
+        }
+        for (VkFence fence : fences)
+        {
+            if (--fenceWaiters[fence] == 0)
+            {
+                fenceWaiters.erase(fence);
+                vkResetFences(device_, 1, &fence);
+                fencePool.push_back(fence);
+            }
+        }
+    }
+
+    void Device::reclaimAfter(const TimelinePoint &point, std::function<void()> reclaim)
+    {
+        std::lock_guard<std::mutex> lock{timelineMutex};
+        pendingReclaims.emplace_back(point, std::move(reclaim));
+    }
+
+    void Device::collectCompleted()
+    {
+        std::vector<std::function<void()>> completed;
+        {
+            std::lock_guard<std::mutex> lock{timelineMutex};
+            TimelinePoint reached{};
+            for (size_t i = 0; i < TimelinePoint::QUEUE_COUNT; i++)
+            {
+                reached.values[i] = pollCompletedValue(timelines[i]);
+            }
+
+            auto isReached = [&](const TimelinePoint &point)
+            {
+                for (size_t i = 0; i < TimelinePoint::QUEUE_COUNT; i++)
+                {
+                    if (point.values[i] > reached.values[i])
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            auto firstPending = std::stable_partition(pendingReclaims.begin(), pendingReclaims.end(), [&](const auto &pending)
+                                                      { return isReached(pending.first); });
+            for (auto it = pendingReclaims.begin(); it != firstPending; ++it)
+            {
+                completed.push_back(std::move(it->second));
+            }
+            pendingReclaims.erase(pendingReclaims.begin(), firstPending);
+        }
+
+        // reclaims may queue further reclaims
+        for (auto &reclaim : completed)
+        {
+            reclaim();
+        }
+    }
+
     void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
     {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -607,4 +1413,109 @@ namespace hex
         }
     }
 
-}
\ No newline at end of file
+    VkShaderModule Device::getShaderModule(const std::string &shaderName)
+    {
+        std::lock_guard<std::mutex> lock{shaderMutex};
+
+        auto found = shaderModules.find(shaderName);
+        if (found != shaderModules.end())
+        {
+            return found->second;
+        }
+        return loadShaderModule(shaderName, true);
+    }
+
+    bool Device::reloadShaderModule(const std::string &shaderName)
+    {
+        std::lock_guard<std::mutex> lock{shaderMutex};
+
+        auto found = shaderModules.find(shaderName);
+        VkShaderModule previous = found != shaderModules.end() ? found->second : VK_NULL_HANDLE;
+        // hot reloads always come from disk, the embedded copy is what the build started with
+        return loadShaderModule(shaderName, false) != previous;
+    }
+
+    ShaderReflection Device::getShaderReflection(const std::string &shaderName)
+    {
+        std::lock_guard<std::mutex> lock{shaderMutex};
+
+        auto found = shaderReflections.find(shaderName);
+        if (found == shaderReflections.end())
+        {
+            loadShaderModule(shaderName, true);
+            found = shaderReflections.find(shaderName);
+        }
+        return found->second;
+    }
+
+    VkShaderModule Device::loadShaderModule(const std::string &shaderName, bool allowEmbedded)
+    {
+        const EmbeddedShader *embedded = allowEmbedded ? findEmbeddedShader(shaderName) : nullptr;
+        std::optional<FileView> file;
+        const char *code;
+        size_t codeSize;
+        if (embedded)
+        {
+            code = reinterpret_cast<const char *>(embedded->code);
+            codeSize = embedded->size;
+        }
+        else
+        {
+            file.emplace("shaders/" + shaderName + ".spv");
+            code = file->data();
+            codeSize = file->size();
+        }
+        uint64_t hash = hashBytes(code, codeSize);
+
+        ShaderReflection reflection;
+        try
+        {
+            reflection = ShaderReflection::reflect(code, codeSize);
+        }
+        catch (const std::exception &e)
+        {
+            throw std::runtime_error("failed to reflect shader " + shaderName + ": " + e.what());
+        }
+
+        VkShaderModule module = VK_NULL_HANDLE;
+        auto [first, last] = shaderModulesByHash.equal_range(hash);
+        for (auto cached = first; cached != last; ++cached)
+        {
+            const auto &cachedCode = cached->second.code;
+            if (cachedCode.size() == codeSize && std::memcmp(cachedCode.data(), code, codeSize) == 0)
+            {
+                module = cached->second.module;
+                break;
+            }
+        }
+
+        if (module == VK_NULL_HANDLE)
+        {
+            VkShaderModuleCreateInfo createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            createInfo.codeSize = codeSize;
+            createInfo.pCode = reinterpret_cast<const uint32_t *>(code);
+
+            if (vkCreateShaderModule(device_, &createInfo, nullptr, &module) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create shader module: " + shaderName);
+            }
+            shaderModulesByHash.emplace(hash, CachedShaderModule{std::vector<char>(code, code + codeSize), module});
+        }
+
+        std::cout << "shader " << shaderName << ": " << codeSize << " bytes" << (embedded ? " embedded, " : ", ") << shaderModulesByHash.size() << " modules cached" << std::endl;
+        shaderModules[shaderName] = module;
+        shaderReflections[shaderName] = std::move(reflection);
+        return module;
+    }
+
+    void Device::destroyShaderModules()
+    {
+        for (auto &[hash, cached] : shaderModulesByHash)
+        {
+            vkDestroyShaderModule(device_, cached.module, nullptr);
+        }
+        shaderModulesByHash.clear();
+        shaderModules.clear();
+    }
+}
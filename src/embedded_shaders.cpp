@@ -0,0 +1,25 @@
+#include "embedded_shaders.hpp"
+
+namespace hex
+{
+#ifdef HEX_EMBED_SHADERS
+// generated by cmake/embed_shaders.cmake from the build's SPIR-V
+#include "embedded_shaders.inc"
+#endif
+
+    const EmbeddedShader *findEmbeddedShader(const std::string &shaderName)
+    {
+#ifdef HEX_EMBED_SHADERS
+        for (const auto &shader : EMBEDDED_SHADERS)
+        {
+            if (shaderName == shader.name)
+            {
+                return &shader;
+            }
+        }
+#else
+        (void)shaderName;
+#endif
+        return nullptr;
+    }
+}
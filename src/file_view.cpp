@@ -0,0 +1,186 @@
+#include "file_view.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HEX_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hex
+{
+    FileView::FileView(const std::string &filepath, Mode mode)
+    {
+        if (mode == Mode::Mapped && map(filepath))
+        {
+            return;
+        }
+        read(filepath);
+    }
+
+    FileView::~FileView()
+    {
+        release();
+    }
+
+    FileView::FileView(FileView &&other) noexcept
+        : bytes{std::exchange(other.bytes, nullptr)}, length{std::exchange(other.length, 0)}, mapped{std::exchange(other.mapped, false)}, buffer{std::move(other.buffer)}
+    {
+    }
+
+    FileView &FileView::operator=(FileView &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+            mapped = std::exchange(other.mapped, false);
+            buffer = std::move(other.buffer);
+        }
+        return *this;
+    }
+
+    bool FileView::map(const std::string &filepath)
+    {
+#ifdef HEX_HAS_MMAP
+        int fd = ::open(filepath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat status{};
+        if (fstat(fd, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void *address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            return false;
+        }
+
+        // whole files are read front to back, let the kernel read ahead aggressively
+        madvise(address, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+        bytes = static_cast<const char *>(address);
+        length = static_cast<size_t>(status.st_size);
+        mapped = true;
+        return true;
+#else
+        (void)filepath;
+        return false;
+#endif
+    }
+
+    void FileView::read(const std::string &filepath)
+    {
+        std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open file: " + filepath);
+        }
+
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (!file)
+        {
+            throw std::runtime_error("failed to read file: " + filepath);
+        }
+
+        bytes = buffer.data();
+        length = buffer.size();
+        mapped = false;
+    }
+
+    void FileView::release()
+    {
+#ifdef HEX_HAS_MMAP
+        if (mapped)
+        {
+            munmap(const_cast<char *>(bytes), length);
+        }
+#endif
+        bytes = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+    }
+
+    void FileView::benchmark(const std::string &filepath, uint32_t iterations)
+    {
+        auto touch = [](const char *data, size_t size)
+        {
+            // every loader reads every byte, so does the benchmark
+            uint64_t sum = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+                sum += static_cast<unsigned char>(data[i]);
+            }
+            return sum;
+        };
+
+        auto measure = [&](auto &&load)
+        {
+            uint64_t checksum = 0;
+            size_t bytes = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                bytes += load(checksum);
+            }
+            float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            // the checksum is printed, which keeps the touch loops from being optimized away
+            return std::make_pair(seconds > 0.0f ? bytes / seconds / (1024.0f * 1024.0f) : 0.0f, checksum);
+        };
+
+        auto [ifstreamRate, ifstreamChecksum] = measure([&](uint64_t &checksum)
+                                     {
+                                         // the path readShader and the mesh cache used before
+                                         std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+                                         if (!file.is_open())
+                                         {
+                                             throw std::runtime_error("failed to open file: " + filepath);
+                                         }
+                                         size_t size = static_cast<size_t>(file.tellg());
+                                         std::vector<char> data(size);
+                                         file.seekg(0);
+                                         file.read(data.data(), static_cast<std::streamsize>(size));
+                                         checksum += touch(data.data(), size);
+                                         return size; });
+
+        auto [bufferedRate, bufferedChecksum] = measure([&](uint64_t &checksum)
+                                     {
+                                         FileView view{filepath, Mode::Buffered};
+                                         checksum += touch(view.data(), view.size());
+                                         return view.size(); });
+
+        bool mappable = false;
+        auto [mappedRate, mappedChecksum] = measure([&](uint64_t &checksum)
+                                   {
+                                       FileView view{filepath, Mode::Mapped};
+                                       mappable = view.isMapped();
+                                       checksum += touch(view.data(), view.size());
+                                       return view.size(); });
+
+        std::cout << "file read benchmark " << filepath << ": ifstream " << ifstreamRate << " MB/s, buffered " << bufferedRate << " MB/s, "
+                  << (mappable ? "mapped " : "mapping unavailable, fallback ") << mappedRate << " MB/s, checksum " << ifstreamChecksum << std::endl;
+        if (bufferedChecksum != ifstreamChecksum || mappedChecksum != ifstreamChecksum)
+        {
+            std::cerr << "file read benchmark " << filepath << ": checksums differ, buffered " << bufferedChecksum << ", mapped " << mappedChecksum << std::endl;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#include "frame_buffer_ring.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace hex
+{
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    FrameBufferRing::FrameBufferRing(Device &device, VkDeviceSize frameSize, VkBufferUsageFlags usage, uint32_t frameCount) : device{device}
+    {
+        const auto &limits = device.properties.limits;
+        alignment = std::max<VkDeviceSize>({1, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment});
+        this->frameSize = alignUp(frameSize, alignment);
+
+        device.createBuffer(
+            this->frameSize * frameCount,
+            usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            buffer,
+            memory);
+        vkMapMemory(device.device(), memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&mapped));
+    }
+
+    FrameBufferRing::~FrameBufferRing()
+    {
+        vkUnmapMemory(device.device(), memory);
+        vkDestroyBuffer(device.device(), buffer, nullptr);
+        vkFreeMemory(device.device(), memory, nullptr);
+    }
+
+    void FrameBufferRing::beginFrame(uint32_t frameIndex)
+    {
+        frameBegin = frameSize * frameIndex;
+        cursor = frameBegin;
+    }
+
+    FrameBufferRing::Allocation FrameBufferRing::allocate(VkDeviceSize size)
+    {
+        VkDeviceSize offset = alignUp(cursor, alignment);
+        if (offset + size > frameBegin + frameSize)
+        {
+            throw std::runtime_error("frame buffer ring exhausted");
+        }
+
+        cursor = offset + size;
+        return {mapped + offset, static_cast<uint32_t>(offset)};
+    }
+}
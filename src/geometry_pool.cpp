@@ -0,0 +1,450 @@
+#include "geometry_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace hex
+{
+    GeometryPool::RangeAllocator::RangeAllocator(uint32_t capacity)
+    {
+        freeRanges[0] = capacity;
+    }
+
+    bool GeometryPool::RangeAllocator::allocate(uint32_t count, GeometryRange &range)
+    {
+        range = {};
+        if (count == 0)
+        {
+            return true;
+        }
+
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            if (it->second < count)
+            {
+                continue;
+            }
+
+            range.offset = it->first;
+            range.count = count;
+            uint32_t remaining = it->second - count;
+            freeRanges.erase(it);
+            if (remaining > 0)
+            {
+                freeRanges[range.offset + count] = remaining;
+            }
+
+            usedCount += count;
+            return true;
+        }
+
+        return false;
+    }
+
+    void GeometryPool::RangeAllocator::free(const GeometryRange &range)
+    {
+        if (range.count == 0)
+        {
+            return;
+        }
+
+        usedCount -= range.count;
+        auto inserted = freeRanges.emplace(range.offset, range.count).first;
+
+        auto next = std::next(inserted);
+        if (next != freeRanges.end() && inserted->first + inserted->second == next->first)
+        {
+            inserted->second += next->second;
+            freeRanges.erase(next);
+        }
+
+        if (inserted != freeRanges.begin())
+        {
+            auto previous = std::prev(inserted);
+            if (previous->first + previous->second == inserted->first)
+            {
+                previous->second += inserted->second;
+                freeRanges.erase(inserted);
+            }
+        }
+    }
+
+    GeometryPool::GeometryPool(Device &device, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshletCapacity)
+        : device{device},
+          vertexAllocator{vertexCapacity},
+          index16Allocator{indexCapacity},
+          index32Allocator{indexCapacity},
+          meshletAllocator{meshletCapacity}
+    {
+        device.createBuffer(
+            sizeof(Model::Vertex) * vertexCapacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            vertexBuffer,
+            vertexBufferMemory);
+        device.createBuffer(
+            sizeof(uint16_t) * indexCapacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            index16Buffer,
+            index16BufferMemory);
+        device.createBuffer(
+            sizeof(uint32_t) * indexCapacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            index32Buffer,
+            index32BufferMemory);
+        // culling may read meshlets on the async compute queue, so they are shared rather than handed over
+        const auto &families = device.getQueueFamilies();
+        std::vector<uint32_t> meshletFamilies{families.graphicsFamily};
+        if (families.transferFamilyHasValue)
+        {
+            meshletFamilies.push_back(families.transferFamily);
+        }
+        if (families.computeFamilyHasValue)
+        {
+            meshletFamilies.push_back(families.computeFamily);
+        }
+        device.createBuffer(
+            sizeof(Model::Meshlet) * meshletCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            meshletBuffer,
+            meshletBufferMemory,
+            meshletFamilies);
+    }
+
+    GeometryPool::~GeometryPool()
+    {
+        vkDestroyBuffer(device.device(), vertexBuffer, nullptr);
+        vkFreeMemory(device.device(), vertexBufferMemory, nullptr);
+        vkDestroyBuffer(device.device(), index16Buffer, nullptr);
+        vkFreeMemory(device.device(), index16BufferMemory, nullptr);
+        vkDestroyBuffer(device.device(), index32Buffer, nullptr);
+        vkFreeMemory(device.device(), index32BufferMemory, nullptr);
+        vkDestroyBuffer(device.device(), meshletBuffer, nullptr);
+        vkFreeMemory(device.device(), meshletBufferMemory, nullptr);
+    }
+
+    static VkIndexType chooseIndexType(const std::vector<uint32_t> &indices)
+    {
+        uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+        return maxIndex < Model::MAX_16BIT_INDEXED_VERTICES ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    static VkDeviceSize alignStaging(VkDeviceSize offset)
+    {
+        return (offset + 15) & ~VkDeviceSize(15);
+    }
+
+    VkDeviceSize GeometryPool::getUploadSize(const Model::Builder &builder)
+    {
+        VkDeviceSize indexSize = chooseIndexType(builder.indices) == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        return alignStaging(sizeof(Model::Vertex) * builder.vertices.size()) +
+               alignStaging(indexSize * builder.indices.size()) +
+               alignStaging(sizeof(Model::Meshlet) * builder.meshlets.size());
+    }
+
+    GeometryAllocation GeometryPool::allocate(const Model::Builder &builder)
+    {
+        UploadBatch batch{};
+        auto allocations = allocate({&builder}, batch);
+        device.waitFor(batch.completion);
+        finishUpload(batch);
+        return allocations[0];
+    }
+
+    VkCommandBuffer GeometryPool::beginUploadCommands(VkCommandPool commandPool)
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        return commandBuffer;
+    }
+
+    std::vector<GeometryAllocation> GeometryPool::allocate(const std::vector<const Model::Builder *> &builders, UploadBatch &batch)
+    {
+        releaseRetired();
+
+        std::vector<GeometryAllocation> allocations;
+        allocations.reserve(builders.size());
+
+        VkDeviceSize stagingSize = 0;
+        for (const auto *builder : builders)
+        {
+            GeometryAllocation allocation{};
+            allocation.indexType = chooseIndexType(builder->indices);
+            auto &indexAllocator = allocation.indexType == VK_INDEX_TYPE_UINT16 ? index16Allocator : index32Allocator;
+
+            const char *exhausted = nullptr;
+            if (!vertexAllocator.allocate(static_cast<uint32_t>(builder->vertices.size()), allocation.vertices))
+            {
+                exhausted = "vertex";
+            }
+            else if (!indexAllocator.allocate(static_cast<uint32_t>(builder->indices.size()), allocation.indices))
+            {
+                vertexAllocator.free(allocation.vertices);
+                exhausted = "index";
+            }
+            else if (!meshletAllocator.allocate(static_cast<uint32_t>(builder->meshlets.size()), allocation.meshlets))
+            {
+                vertexAllocator.free(allocation.vertices);
+                indexAllocator.free(allocation.indices);
+                exhausted = "meshlet";
+            }
+
+            if (exhausted)
+            {
+                for (const auto &allocated : allocations)
+                {
+                    release(allocated);
+                }
+                throw std::runtime_error(std::string("geometry pool is out of ") + exhausted + " space");
+            }
+
+            allocations.push_back(allocation);
+            stagingSize += getUploadSize(*builder);
+        }
+
+        batch = {};
+        if (stagingSize == 0)
+        {
+            return allocations;
+        }
+
+        device.createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, batch.stagingBuffer, batch.stagingBufferMemory);
+
+        char *mapped;
+        vkMapMemory(device.device(), batch.stagingBufferMemory, 0, stagingSize, 0, reinterpret_cast<void **>(&mapped));
+
+        // the copy engine moves the bytes while the graphics queue keeps rendering
+        bool dedicatedTransfer = device.capabilities.dedicatedTransferQueue;
+        batch.commandBuffer = beginUploadCommands(dedicatedTransfer ? device.getTransferCommandPool() : device.getCommandPool());
+
+        std::vector<VkBufferCopy> vertexCopies, index16Copies, index32Copies, meshletCopies;
+        VkDeviceSize stagingOffset = 0;
+        for (size_t i = 0; i < builders.size(); i++)
+        {
+            const auto &builder = *builders[i];
+            const auto &allocation = allocations[i];
+
+            VkDeviceSize vertexBytes = sizeof(Model::Vertex) * builder.vertices.size();
+            if (vertexBytes > 0)
+            {
+                memcpy(mapped + stagingOffset, builder.vertices.data(), static_cast<size_t>(vertexBytes));
+                vertexCopies.push_back({stagingOffset, sizeof(Model::Vertex) * allocation.vertices.offset, vertexBytes});
+                stagingOffset = alignStaging(stagingOffset + vertexBytes);
+            }
+
+            bool narrow = allocation.indexType == VK_INDEX_TYPE_UINT16;
+            VkDeviceSize indexSize = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+            VkDeviceSize indexBytes = indexSize * builder.indices.size();
+            if (indexBytes > 0)
+            {
+                if (narrow)
+                {
+                    std::copy(builder.indices.begin(), builder.indices.end(), reinterpret_cast<uint16_t *>(mapped + stagingOffset));
+                }
+                else
+                {
+                    memcpy(mapped + stagingOffset, builder.indices.data(), static_cast<size_t>(indexBytes));
+                }
+                (narrow ? index16Copies : index32Copies).push_back({stagingOffset, indexSize * allocation.indices.offset, indexBytes});
+                stagingOffset = alignStaging(stagingOffset + indexBytes);
+            }
+
+            VkDeviceSize meshletBytes = sizeof(Model::Meshlet) * builder.meshlets.size();
+            if (meshletBytes > 0)
+            {
+                auto *meshlets = reinterpret_cast<Model::Meshlet *>(mapped + stagingOffset);
+                std::copy(builder.meshlets.begin(), builder.meshlets.end(), meshlets);
+                for (size_t m = 0; m < builder.meshlets.size(); m++)
+                {
+                    meshlets[m].firstIndex += allocation.indices.offset;
+                    meshlets[m].vertexOffset += static_cast<int32_t>(allocation.vertices.offset);
+                }
+                meshletCopies.push_back({stagingOffset, sizeof(Model::Meshlet) * allocation.meshlets.offset, meshletBytes});
+                stagingOffset = alignStaging(stagingOffset + meshletBytes);
+            }
+        }
+        vkUnmapMemory(device.device(), batch.stagingBufferMemory);
+
+        // exclusive buffers written on the transfer queue are released range by range to the graphics family,
+        // which acquires the same ranges before drawing from them
+        const auto &families = device.getQueueFamilies();
+        std::vector<VkBufferMemoryBarrier> ownershipBarriers;
+        auto copy = [&](VkBuffer dstBuffer, const std::vector<VkBufferCopy> &regions, bool exclusive)
+        {
+            if (regions.empty())
+            {
+                return;
+            }
+            vkCmdCopyBuffer(batch.commandBuffer, batch.stagingBuffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+            if (!dedicatedTransfer || !exclusive)
+            {
+                return;
+            }
+            for (const auto &region : regions)
+            {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = families.transferFamily;
+                barrier.dstQueueFamilyIndex = families.graphicsFamily;
+                barrier.buffer = dstBuffer;
+                barrier.offset = region.dstOffset;
+                barrier.size = region.size;
+                ownershipBarriers.push_back(barrier);
+            }
+        };
+        copy(vertexBuffer, vertexCopies, true);
+        copy(index16Buffer, index16Copies, true);
+        copy(index32Buffer, index32Copies, true);
+        copy(meshletBuffer, meshletCopies, false);
+
+        if (!ownershipBarriers.empty())
+        {
+            for (auto &barrier : ownershipBarriers)
+            {
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = 0;
+            }
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                 static_cast<uint32_t>(ownershipBarriers.size()), ownershipBarriers.data(), 0, nullptr);
+        }
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        if (!dedicatedTransfer)
+        {
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &batch.commandBuffer;
+            batch.completion = device.submit(QueueType::Graphics, submitInfo);
+            return allocations;
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &batch.transferComplete) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload semaphore");
+        }
+
+        VkSubmitInfo transferSubmit{};
+        transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &batch.commandBuffer;
+        transferSubmit.signalSemaphoreCount = 1;
+        transferSubmit.pSignalSemaphores = &batch.transferComplete;
+        batch.completion = device.submit(QueueType::Transfer, transferSubmit);
+
+        // the acquire half only waits for the copies, it is a handful of barriers on the graphics queue
+        batch.acquireCommandBuffer = beginUploadCommands(device.getCommandPool());
+        if (!ownershipBarriers.empty())
+        {
+            for (auto &barrier : ownershipBarriers)
+            {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            }
+            vkCmdPipelineBarrier(batch.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr,
+                                 static_cast<uint32_t>(ownershipBarriers.size()), ownershipBarriers.data(), 0, nullptr);
+        }
+        vkEndCommandBuffer(batch.acquireCommandBuffer);
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireSubmit{};
+        acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireSubmit.waitSemaphoreCount = 1;
+        acquireSubmit.pWaitSemaphores = &batch.transferComplete;
+        acquireSubmit.pWaitDstStageMask = &waitStage;
+        acquireSubmit.commandBufferCount = 1;
+        acquireSubmit.pCommandBuffers = &batch.acquireCommandBuffer;
+        batch.completion.merge(device.submit(QueueType::Graphics, acquireSubmit));
+
+        return allocations;
+    }
+
+    bool GeometryPool::isUploadComplete(const UploadBatch &batch) const
+    {
+        return device.isComplete(batch.completion);
+    }
+
+    void GeometryPool::finishUpload(UploadBatch &batch)
+    {
+        VkDevice logicalDevice = device.device();
+        VkCommandPool transferPool = device.getTransferCommandPool();
+        VkCommandPool graphicsPool = device.getCommandPool();
+        device.reclaimAfter(batch.completion, [logicalDevice, transferPool, graphicsPool, batch]()
+                            {
+                                if (batch.commandBuffer != VK_NULL_HANDLE)
+                                {
+                                    VkCommandPool commandPool = batch.acquireCommandBuffer != VK_NULL_HANDLE ? transferPool : graphicsPool;
+                                    vkFreeCommandBuffers(logicalDevice, commandPool, 1, &batch.commandBuffer);
+                                }
+                                if (batch.acquireCommandBuffer != VK_NULL_HANDLE)
+                                {
+                                    vkFreeCommandBuffers(logicalDevice, graphicsPool, 1, &batch.acquireCommandBuffer);
+                                }
+                                if (batch.transferComplete != VK_NULL_HANDLE)
+                                {
+                                    vkDestroySemaphore(logicalDevice, batch.transferComplete, nullptr);
+                                }
+                                if (batch.stagingBuffer != VK_NULL_HANDLE)
+                                {
+                                    vkDestroyBuffer(logicalDevice, batch.stagingBuffer, nullptr);
+                                    vkFreeMemory(logicalDevice, batch.stagingBufferMemory, nullptr);
+                                } });
+        batch = {};
+    }
+
+    void GeometryPool::free(const GeometryAllocation &allocation)
+    {
+        retired.emplace_back(device.getRetirePoint(), allocation);
+    }
+
+    void GeometryPool::releaseRetired()
+    {
+        // retire points only grow, so the first one still in use ends the scan
+        while (!retired.empty() && device.isComplete(retired.front().first))
+        {
+            release(retired.front().second);
+            retired.pop_front();
+        }
+    }
+
+    void GeometryPool::release(const GeometryAllocation &allocation)
+    {
+        vertexAllocator.free(allocation.vertices);
+        (allocation.indexType == VK_INDEX_TYPE_UINT16 ? index16Allocator : index32Allocator).free(allocation.indices);
+        meshletAllocator.free(allocation.meshlets);
+    }
+
+    void GeometryPool::bindVertexBuffer(VkCommandBuffer commandBuffer)
+    {
+        VkBuffer buffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    }
+
+    void GeometryPool::bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType)
+    {
+        vkCmdBindIndexBuffer(commandBuffer, indexType == VK_INDEX_TYPE_UINT16 ? index16Buffer : index32Buffer, 0, indexType);
+    }
+
+    uint32_t GeometryPool::getIndexUsage(VkIndexType indexType) const
+    {
+        return indexType == VK_INDEX_TYPE_UINT16 ? index16Allocator.used() : index32Allocator.used();
+    }
+}
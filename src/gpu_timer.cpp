@@ -0,0 +1,65 @@
+#include "gpu_timer.hpp"
+
+#include <stdexcept>
+
+namespace hex
+{
+    bool GpuTimer::isSupported(Device &device)
+    {
+        return device.graphicsQueueTimestampBits > 0 && device.properties.limits.timestampPeriod > 0.0f;
+    }
+
+    GpuTimer::GpuTimer(Device &device, uint32_t frameCount) : device{device}, written(frameCount, false)
+    {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = frameCount * 2;
+
+        if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+
+        uint32_t validBits = device.graphicsQueueTimestampBits;
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    }
+
+    GpuTimer::~GpuTimer()
+    {
+        vkDestroyQueryPool(device.device(), queryPool, nullptr);
+    }
+
+    void GpuTimer::readResults(uint32_t frameIndex)
+    {
+        if (!written[frameIndex])
+        {
+            return;
+        }
+
+        uint64_t timestamps[2];
+        VkResult result = vkGetQueryPoolResults(device.device(), queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+        {
+            return;
+        }
+
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+        lastMilliseconds = static_cast<float>(ticks * static_cast<double>(device.properties.limits.timestampPeriod) * 1e-6);
+    }
+
+    void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        // beginFrame waited for the slot's last submission, so the slot's previous timestamps are final
+        readResults(frameIndex);
+
+        vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+    }
+
+    void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+        written[frameIndex] = true;
+    }
+}
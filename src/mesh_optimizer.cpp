@@ -0,0 +1,853 @@
+#include "mesh_optimizer.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace hex
+{
+    static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+    // keeps open borders from shrinking before the interior has been simplified
+    static constexpr double BOUNDARY_WEIGHT = 10.0;
+
+    struct Quadric
+    {
+        double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0, ad = 0, bd = 0, cd = 0, d2 = 0;
+        double weight = 0;
+
+        static Quadric fromPlane(const glm::vec3 &normal, float distance, double weight)
+        {
+            double a = normal.x, b = normal.y, c = normal.z, d = distance;
+            Quadric q{};
+            q.a2 = a * a * weight;
+            q.b2 = b * b * weight;
+            q.c2 = c * c * weight;
+            q.ab = a * b * weight;
+            q.ac = a * c * weight;
+            q.bc = b * c * weight;
+            q.ad = a * d * weight;
+            q.bd = b * d * weight;
+            q.cd = c * d * weight;
+            q.d2 = d * d * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &o)
+        {
+            a2 += o.a2, b2 += o.b2, c2 += o.c2, ab += o.ab, ac += o.ac, bc += o.bc;
+            ad += o.ad, bd += o.bd, cd += o.cd, d2 += o.d2, weight += o.weight;
+            return *this;
+        }
+
+        // weighted mean squared distance of the point to the accumulated planes
+        double error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a2 * x * x + b2 * y * y + c2 * z * z + 2 * (ab * x * y + ac * x * z + bc * y * z) + 2 * (ad * x + bd * y + cd * z) + d2;
+            return weight > 0 ? std::fabs(r) / weight : 0.0;
+        }
+    };
+
+    VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        VertexCacheStatistics stats{};
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+        {
+            return stats;
+        }
+
+        // a vertex stays resident until cacheSize further misses have pushed it out of the FIFO
+        std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        uint32_t misses = 0;
+        uint32_t uniqueVertices = 0;
+
+        for (uint32_t index : indices)
+        {
+            if (cacheTimestamps[index] == 0 || misses - cacheTimestamps[index] >= cacheSize)
+            {
+                misses++;
+                cacheTimestamps[index] = misses;
+            }
+
+            if (!referenced[index])
+            {
+                referenced[index] = true;
+                uniqueVertices++;
+            }
+        }
+
+        stats.acmr = static_cast<float>(misses) / static_cast<float>(triangleCount);
+        stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+        return stats;
+    }
+
+    std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        const size_t triangleCount = indices.size() / 3;
+
+        // vertex -> triangle adjacency, stored as one flat array with per-vertex offsets
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (uint32_t index : indices)
+        {
+            liveTriangles[index]++;
+        }
+
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+        }
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fillCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            adjacency[fillCursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEndStack;
+        std::vector<uint32_t> candidates;
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        uint32_t timestamp = cacheSize + 1;
+        size_t scanCursor = 0;
+
+        auto skipDeadEnd = [&]() -> uint32_t
+        {
+            // prefer recently emitted vertices, they are the most likely to still be cached
+            while (!deadEndStack.empty())
+            {
+                uint32_t vertex = deadEndStack.back();
+                deadEndStack.pop_back();
+                if (liveTriangles[vertex] > 0)
+                {
+                    return vertex;
+                }
+            }
+
+            for (; scanCursor < vertexCount; scanCursor++)
+            {
+                if (liveTriangles[scanCursor] > 0)
+                {
+                    return static_cast<uint32_t>(scanCursor);
+                }
+            }
+
+            return INVALID_INDEX;
+        };
+
+        uint32_t fanningVertex = skipDeadEnd();
+        while (fanningVertex != INVALID_INDEX)
+        {
+            candidates.clear();
+
+            for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++)
+            {
+                uint32_t triangle = adjacency[a];
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t vertex = indices[triangle * 3 + k];
+                    result.push_back(vertex);
+                    deadEndStack.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+
+                    if (timestamp - cacheTimestamps[vertex] > cacheSize)
+                    {
+                        cacheTimestamps[vertex] = timestamp++;
+                    }
+                }
+
+                emitted[triangle] = true;
+            }
+
+            // pick the oldest candidate that will still be cached after all of its triangles are emitted
+            uint32_t nextVertex = INVALID_INDEX;
+            uint32_t bestPriority = 0;
+            for (uint32_t vertex : candidates)
+            {
+                if (liveTriangles[vertex] == 0)
+                {
+                    continue;
+                }
+
+                uint32_t priority = 0;
+                if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                {
+                    priority = timestamp - cacheTimestamps[vertex];
+                }
+
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    nextVertex = vertex;
+                }
+            }
+
+            if (nextVertex == INVALID_INDEX)
+            {
+                nextVertex = skipDeadEnd();
+            }
+
+            fanningVertex = nextVertex;
+        }
+
+        return result;
+    }
+
+    void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, uint32_t cacheSize)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // a triangle whose three vertices all miss the cache marks a hard boundary, moving clusters
+        // around at those points costs nothing in vertex reuse
+        std::vector<uint32_t> clusterStarts;
+        std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+        uint32_t misses = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            uint32_t triangleMisses = 0;
+            for (size_t k = 0; k < 3; k++)
+            {
+                uint32_t index = indices[t * 3 + k];
+                if (cacheTimestamps[index] == 0 || misses - cacheTimestamps[index] >= cacheSize)
+                {
+                    misses++;
+                    triangleMisses++;
+                    cacheTimestamps[index] = misses;
+                }
+            }
+
+            if (t == 0 || triangleMisses == 3)
+            {
+                clusterStarts.push_back(static_cast<uint32_t>(t));
+            }
+        }
+
+        if (clusterStarts.size() < 2)
+        {
+            return;
+        }
+        clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+        glm::vec3 meshCentroid{0.0f};
+        for (uint32_t index : indices)
+        {
+            meshCentroid += vertices[index].position;
+        }
+        meshCentroid /= static_cast<float>(indices.size());
+
+        const size_t clusterCount = clusterStarts.size() - 1;
+        std::vector<float> sortKeys(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            glm::vec3 centroid{0.0f};
+            glm::vec3 normal{0.0f};
+            float area = 0.0f;
+
+            for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+            {
+                const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+
+                glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+                float triangleArea = glm::length(weightedNormal);
+
+                centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+                normal += weightedNormal;
+                area += triangleArea;
+            }
+
+            float normalLength = glm::length(normal);
+            if (area <= 0.0f || normalLength <= 0.0f)
+            {
+                sortKeys[c] = 0.0f;
+                continue;
+            }
+
+            centroid /= area;
+            sortKeys[c] = glm::dot(centroid - meshCentroid, normal / normalLength);
+        }
+
+        std::vector<size_t> clusterOrder(clusterCount);
+        std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+        std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](size_t a, size_t b)
+                         { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t c : clusterOrder)
+        {
+            result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        }
+
+        indices.swap(result);
+    }
+
+    void MeshOptimizer::optimizeVertexFetch(std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+        std::vector<MeshVertex> reordered;
+        reordered.reserve(vertices.size());
+
+        for (uint32_t &index : indices)
+        {
+            if (remap[index] == INVALID_INDEX)
+            {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        vertices.swap(reordered);
+    }
+
+    std::vector<uint32_t> MeshOptimizer::simplify(
+        const std::vector<uint32_t> &indices,
+        const std::vector<MeshVertex> &vertices,
+        size_t targetIndexCount,
+        float targetError,
+        float *resultError)
+    {
+        if (resultError)
+        {
+            *resultError = 0.0f;
+        }
+
+        // collapses happen between positions, vertices that only differ in their attributes move together
+        std::unordered_map<glm::vec3, uint32_t> positionIds{};
+        std::vector<uint32_t> positionOf(vertices.size());
+        std::vector<uint32_t> canonicalVertex;
+        std::vector<glm::vec3> positions;
+        glm::vec3 minBounds{std::numeric_limits<float>::max()};
+        glm::vec3 maxBounds{std::numeric_limits<float>::lowest()};
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto [it, inserted] = positionIds.emplace(vertices[i].position, static_cast<uint32_t>(positions.size()));
+            if (inserted)
+            {
+                positions.push_back(vertices[i].position);
+                canonicalVertex.push_back(static_cast<uint32_t>(i));
+                minBounds = glm::min(minBounds, vertices[i].position);
+                maxBounds = glm::max(maxBounds, vertices[i].position);
+            }
+            positionOf[i] = it->second;
+        }
+
+        glm::vec3 size = maxBounds - minBounds;
+        float extent = glm::max(size.x, glm::max(size.y, size.z));
+        if (indices.size() <= targetIndexCount || extent <= 0.0f)
+        {
+            return indices;
+        }
+
+        const size_t positionCount = positions.size();
+        std::vector<Quadric> quadrics(positionCount);
+
+        std::unordered_map<uint64_t, uint32_t> edgeUse{};
+        auto edgeKey = [](uint32_t a, uint32_t b)
+        {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        };
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            uint32_t p[3] = {positionOf[indices[t]], positionOf[indices[t + 1]], positionOf[indices[t + 2]]};
+            glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+            {
+                continue;
+            }
+            normal /= length;
+
+            Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, positions[p[0]]), length * 0.5);
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                quadrics[p[k]] += plane;
+                edgeUse[edgeKey(p[k], p[(k + 1) % 3])]++;
+            }
+        }
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            uint32_t p[3] = {positionOf[indices[t]], positionOf[indices[t + 1]], positionOf[indices[t + 2]]};
+            glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            if (glm::length(normal) <= 0.0f)
+            {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                uint32_t a = p[k], b = p[(k + 1) % 3];
+                if (edgeUse[edgeKey(a, b)] != 1)
+                {
+                    continue;
+                }
+
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 borderNormal = glm::cross(edge, normal);
+                float borderLength = glm::length(borderNormal);
+                if (borderLength <= 0.0f)
+                {
+                    continue;
+                }
+                borderNormal /= borderLength;
+
+                float edgeLength = glm::length(edge);
+                Quadric border = Quadric::fromPlane(borderNormal, -glm::dot(borderNormal, positions[a]), edgeLength * edgeLength * BOUNDARY_WEIGHT);
+                quadrics[a] += border;
+                quadrics[b] += border;
+            }
+        }
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            double error;
+        };
+
+        const double errorLimit = static_cast<double>(targetError) * extent;
+        const double errorLimitSquared = errorLimit * errorLimit;
+        double maxError = 0.0;
+
+        std::vector<uint32_t> result = indices;
+        std::vector<uint32_t> collapsedInto(positionCount);
+        std::iota(collapsedInto.begin(), collapsedInto.end(), 0);
+
+        std::vector<uint32_t> adjacencyOffsets;
+        std::vector<uint32_t> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> locked;
+
+        while (result.size() > targetIndexCount)
+        {
+            const size_t triangleCount = result.size() / 3;
+
+            // position -> live triangle adjacency for this pass
+            adjacencyOffsets.assign(positionCount + 1, 0);
+            for (uint32_t index : result)
+            {
+                adjacencyOffsets[positionOf[index] + 1]++;
+            }
+            for (size_t p = 0; p < positionCount; p++)
+            {
+                adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+            }
+            adjacency.resize(result.size());
+            std::vector<uint32_t> fillCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                adjacency[fillCursor[positionOf[result[i]]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t a = positionOf[result[t * 3 + k]];
+                    uint32_t b = positionOf[result[t * 3 + (k + 1) % 3]];
+                    if (a == b)
+                    {
+                        continue;
+                    }
+
+                    Quadric combined = quadrics[a];
+                    combined += quadrics[b];
+                    double intoB = combined.error(positions[b]);
+                    double intoA = combined.error(positions[a]);
+
+                    if (intoB <= intoA)
+                    {
+                        collapses.push_back({a, b, intoB});
+                    }
+                    else
+                    {
+                        collapses.push_back({b, a, intoA});
+                    }
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &l, const Collapse &r)
+                      { return l.error < r.error; });
+
+            auto flipsTriangle = [&](uint32_t from, uint32_t to)
+            {
+                for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+                {
+                    uint32_t triangle = adjacency[a];
+                    uint32_t p[3] = {positionOf[result[triangle * 3]], positionOf[result[triangle * 3 + 1]], positionOf[result[triangle * 3 + 2]]};
+                    if (p[0] == to || p[1] == to || p[2] == to)
+                    {
+                        continue;
+                    }
+
+                    glm::vec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                    for (uint32_t &position : p)
+                    {
+                        position = position == from ? to : position;
+                    }
+                    glm::vec3 after = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+
+                    if (glm::dot(before, after) <= 0.0f)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            };
+
+            // one collapse per neighbourhood and pass keeps the adjacency and flip tests above valid
+            locked.assign(positionCount, false);
+            size_t remainingTriangles = triangleCount;
+            size_t applied = 0;
+
+            for (const auto &collapse : collapses)
+            {
+                if (collapse.error > errorLimitSquared || remainingTriangles * 3 <= targetIndexCount)
+                {
+                    break;
+                }
+
+                if (locked[collapse.from] || locked[collapse.to] || flipsTriangle(collapse.from, collapse.to))
+                {
+                    continue;
+                }
+
+                for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+                {
+                    uint32_t triangle = adjacency[a];
+                    bool dies = false;
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        uint32_t position = positionOf[result[triangle * 3 + k]];
+                        locked[position] = true;
+                        dies |= position == collapse.to;
+                    }
+                    remainingTriangles -= dies ? 1 : 0;
+                }
+
+                collapsedInto[collapse.from] = collapse.to;
+                quadrics[collapse.to] += quadrics[collapse.from];
+                maxError = std::max(maxError, collapse.error);
+                applied++;
+            }
+
+            if (applied == 0)
+            {
+                break;
+            }
+
+            size_t write = 0;
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                uint32_t corners[3];
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t index = result[t * 3 + k];
+                    uint32_t position = positionOf[index];
+                    corners[k] = collapsedInto[position] == position ? index : canonicalVertex[collapsedInto[position]];
+                }
+
+                uint32_t p0 = positionOf[corners[0]], p1 = positionOf[corners[1]], p2 = positionOf[corners[2]];
+                if (p0 == p1 || p1 == p2 || p0 == p2)
+                {
+                    continue;
+                }
+
+                result[write++] = corners[0];
+                result[write++] = corners[1];
+                result[write++] = corners[2];
+            }
+            result.resize(write);
+
+            for (size_t p = 0; p < positionCount; p++)
+            {
+                collapsedInto[p] = static_cast<uint32_t>(p);
+            }
+        }
+
+        if (resultError)
+        {
+            *resultError = static_cast<float>(std::sqrt(maxError) / extent);
+        }
+        return result;
+    }
+
+    uint32_t MeshOptimizer::selectLod(const std::vector<MeshLod> &lods, float screenSizePerUnit, float maxScreenError)
+    {
+        uint32_t selected = 0;
+        for (uint32_t lod = 1; lod < lods.size(); lod++)
+        {
+            if (lods[lod].error * screenSizePerUnit <= maxScreenError)
+            {
+                selected = lod;
+            }
+        }
+        return selected;
+    }
+
+    static void computeMeshletBounds(
+        Meshlet &meshlet,
+        const std::vector<uint32_t> &indices,
+        const std::vector<MeshVertex> &vertices,
+        bool coneCulling,
+        float facing)
+    {
+        glm::vec3 minBounds{std::numeric_limits<float>::max()};
+        glm::vec3 maxBounds{std::numeric_limits<float>::lowest()};
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+        {
+            minBounds = glm::min(minBounds, vertices[indices[i]].position);
+            maxBounds = glm::max(maxBounds, vertices[indices[i]].position);
+        }
+
+        meshlet.center = (minBounds + maxBounds) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+        {
+            meshlet.radius = glm::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+        }
+
+        meshlet.coneAxis = glm::vec3{0.0f};
+        meshlet.coneCutoff = 1.0f;
+        if (!coneCulling)
+        {
+            return;
+        }
+
+        std::vector<glm::vec3> normals;
+        glm::vec3 normalSum{0.0f};
+        for (uint32_t i = meshlet.firstIndex; i + 2 < meshlet.firstIndex + meshlet.indexCount; i += 3)
+        {
+            const glm::vec3 &a = vertices[indices[i]].position;
+            const glm::vec3 &b = vertices[indices[i + 1]].position;
+            const glm::vec3 &c = vertices[indices[i + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+            if (area > 0.0f)
+            {
+                normals.push_back(normal * (facing / area));
+                normalSum += normals.back();
+            }
+        }
+
+        float sumLength = glm::length(normalSum);
+        if (normals.empty() || sumLength <= 0.0f)
+        {
+            return;
+        }
+
+        glm::vec3 axis = normalSum / sumLength;
+        float minDot = 1.0f;
+        for (const auto &normal : normals)
+        {
+            minDot = glm::min(minDot, glm::dot(normal, axis));
+        }
+
+        // a cone wider than ~84 degrees can only cull from directions the sphere test rejects anyway
+        if (minDot <= 0.1f)
+        {
+            return;
+        }
+
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    std::vector<Meshlet> MeshOptimizer::buildMeshlets(
+        std::vector<uint32_t> &indices,
+        const std::vector<MeshVertex> &vertices,
+        uint32_t firstIndex,
+        uint32_t indexCount,
+        uint32_t maxVertices,
+        uint32_t maxTriangles)
+    {
+        std::vector<Meshlet> meshlets;
+        const uint32_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+        {
+            return meshlets;
+        }
+
+        const uint32_t *source = indices.data() + firstIndex;
+
+        // back facing meshlets may only be skipped when front faces of the same mesh hide them
+        std::unordered_map<glm::vec3, uint32_t> positionIds{};
+        std::vector<uint32_t> positionOf(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positionOf[i] = positionIds.emplace(vertices[i].position, static_cast<uint32_t>(positionIds.size())).first->second;
+        }
+
+        std::unordered_map<uint64_t, int32_t> edgeBalance{};
+        double signedVolume = 0.0;
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                uint32_t a = positionOf[source[t * 3 + k]];
+                uint32_t b = positionOf[source[t * 3 + (k + 1) % 3]];
+                // consistently wound closed surfaces traverse every edge once in each direction
+                edgeBalance[a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a] += a < b ? 1 : -1;
+            }
+
+            const glm::vec3 &a = vertices[source[t * 3]].position;
+            const glm::vec3 &b = vertices[source[t * 3 + 1]].position;
+            const glm::vec3 &c = vertices[source[t * 3 + 2]].position;
+            signedVolume += glm::dot(a, glm::cross(b, c));
+        }
+
+        bool closed = std::all_of(edgeBalance.begin(), edgeBalance.end(), [](const auto &edge)
+                                  { return edge.second == 0; });
+        float facing = signedVolume < 0.0 ? -1.0f : 1.0f;
+
+        // vertex to triangle adjacency
+        std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1, 0);
+        for (uint32_t i = 0; i < triangleCount * 3; i++)
+        {
+            adjacencyOffsets[source[i] + 1]++;
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < triangleCount * 3; i++)
+        {
+            adjacency[fill[source[i]]++] = i / 3;
+        }
+
+        std::vector<glm::vec3> triangleCenters(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            triangleCenters[t] = (vertices[source[t * 3]].position + vertices[source[t * 3 + 1]].position + vertices[source[t * 3 + 2]].position) / 3.0f;
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<bool> inMeshlet(vertices.size(), false);
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint32_t> ordered;
+        ordered.reserve(triangleCount * 3);
+
+        Meshlet current{};
+        current.firstIndex = firstIndex;
+        glm::vec3 centerSum{0.0f};
+        uint32_t nextUnemitted = 0;
+
+        auto newVertexCount = [&](uint32_t t)
+        {
+            uint32_t a = source[t * 3], b = source[t * 3 + 1], c = source[t * 3 + 2];
+            return uint32_t(!inMeshlet[a]) + uint32_t(b != a && !inMeshlet[b]) + uint32_t(c != a && c != b && !inMeshlet[c]);
+        };
+
+        auto finishMeshlet = [&]()
+        {
+            current.indexCount = firstIndex + static_cast<uint32_t>(ordered.size()) - current.firstIndex;
+            meshlets.push_back(current);
+
+            for (uint32_t vertex : meshletVertices)
+            {
+                inMeshlet[vertex] = false;
+            }
+            meshletVertices.clear();
+            centerSum = glm::vec3{0.0f};
+            current = Meshlet{};
+            current.firstIndex = firstIndex + static_cast<uint32_t>(ordered.size());
+        };
+
+        for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            uint32_t meshletTriangles = (firstIndex + static_cast<uint32_t>(ordered.size()) - current.firstIndex) / 3;
+            glm::vec3 meshletCenter = meshletTriangles > 0 ? centerSum / float(meshletTriangles) : glm::vec3{0.0f};
+
+            // prefer growing the meshlet through its own vertices
+            uint32_t best = INVALID_INDEX;
+            uint32_t bestNew = 4;
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t vertex : meshletVertices)
+            {
+                for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if (emitted[t])
+                    {
+                        continue;
+                    }
+
+                    uint32_t newVertices = newVertexCount(t);
+                    float distance = glm::length(triangleCenters[t] - meshletCenter);
+                    if (newVertices < bestNew || (newVertices == bestNew && distance < bestDistance))
+                    {
+                        best = t;
+                        bestNew = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            if (best == INVALID_INDEX)
+            {
+                while (emitted[nextUnemitted])
+                {
+                    nextUnemitted++;
+                }
+                best = nextUnemitted;
+                bestNew = newVertexCount(best);
+            }
+
+            if (meshletTriangles > 0 && (meshletVertices.size() + bestNew > maxVertices || meshletTriangles + 1 > maxTriangles))
+            {
+                finishMeshlet();
+            }
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                uint32_t vertex = source[best * 3 + k];
+                if (!inMeshlet[vertex])
+                {
+                    inMeshlet[vertex] = true;
+                    meshletVertices.push_back(vertex);
+                }
+                ordered.push_back(vertex);
+            }
+            centerSum += triangleCenters[best];
+            emitted[best] = true;
+        }
+        finishMeshlet();
+
+        std::copy(ordered.begin(), ordered.end(), indices.begin() + firstIndex);
+        for (auto &meshlet : meshlets)
+        {
+            computeMeshletBounds(meshlet, indices, vertices, closed, facing);
+        }
+
+        return meshlets;
+    }
+}
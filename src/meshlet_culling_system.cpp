@@ -0,0 +1,303 @@
+#include "meshlet_culling_system.hpp"
+#include "simple_render_system.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+namespace hex
+{
+    struct MeshletCullPushConstantData
+    {
+        glm::vec4 frustum[6];
+        glm::vec4 cameraPosition;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        uint32_t firstDraw;
+    };
+
+    // Clip space planes of the frustum, in the space the matrix maps from (Vulkan depth range 0..1)
+    static void extractFrustumPlanes(const glm::mat4 &matrix, glm::vec4 planes[6])
+    {
+        auto row = [&](int i)
+        {
+            return glm::vec4{matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]};
+        };
+
+        planes[0] = row(3) + row(0);
+        planes[1] = row(3) - row(0);
+        planes[2] = row(3) + row(1);
+        planes[3] = row(3) - row(1);
+        planes[4] = row(2);
+        planes[5] = row(3) - row(2);
+    }
+
+    bool MeshletCullingSystem::isSupported(Device &device)
+    {
+        return (device.graphicsQueueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+    }
+
+    MeshletCullingSystem::MeshletCullingSystem(Device &device, GeometryPool &geometryPool, PipelineManager &pipelineManager, DescriptorAllocator &descriptorAllocator)
+        : device{device}, geometryPool{geometryPool}, pipelineManager{pipelineManager}, descriptorAllocator{descriptorAllocator}
+    {
+        createPipelineLayout();
+        createMeshletDescriptorSet();
+        createFrameResources();
+        createPipeline();
+        if (device.capabilities.asyncComputeQueue)
+        {
+            createAsyncComputeResources();
+        }
+
+        std::cout << "meshlet culling: compute pass on the " << (device.capabilities.asyncComputeQueue ? "async compute" : "graphics") << " queue, "
+                  << (device.capabilities.multiDrawIndirect ? "multi draw indirect" : "single draw indirect") << std::endl;
+    }
+
+    MeshletCullingSystem::~MeshletCullingSystem()
+    {
+        for (auto &frame : frames)
+        {
+            vkUnmapMemory(device.device(), frame.statsBufferMemory);
+            vkDestroyBuffer(device.device(), frame.statsBuffer, nullptr);
+            vkFreeMemory(device.device(), frame.statsBufferMemory, nullptr);
+            vkDestroyBuffer(device.device(), frame.drawBuffer, nullptr);
+            vkFreeMemory(device.device(), frame.drawBufferMemory, nullptr);
+            if (frame.computeCommandBuffer != VK_NULL_HANDLE)
+            {
+                vkFreeCommandBuffers(device.device(), device.getComputeCommandPool(), 1, &frame.computeCommandBuffer);
+                vkDestroySemaphore(device.device(), frame.cullFinished, nullptr);
+            }
+        }
+
+        pipeline.reset();
+    }
+
+    void MeshletCullingSystem::createMeshletDescriptorSet()
+    {
+        // the pool holds the meshlets of every model, one set serves all dispatches
+        meshletDescriptorSet = descriptorAllocator.allocate(meshletSetLayout);
+        DescriptorWriter{}
+            .writeBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, geometryPool.getMeshletBuffer())
+            .update(device, meshletDescriptorSet);
+    }
+
+    void MeshletCullingSystem::createFrameResources()
+    {
+        // written on the compute queue and read on the graphics queue every frame, sharing beats handing them over
+        std::vector<uint32_t> families{device.getQueueFamilies().graphicsFamily};
+        if (device.capabilities.asyncComputeQueue)
+        {
+            families.push_back(device.getQueueFamilies().computeFamily);
+        }
+
+        for (auto &frame : frames)
+        {
+            device.createBuffer(
+                sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAWS_PER_FRAME,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                frame.drawBuffer,
+                frame.drawBufferMemory,
+                families);
+
+            // read back on the host once the timeline passed the frame's submission, no staging needed for two counters
+            device.createBuffer(
+                sizeof(uint32_t) * 2,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.statsBuffer,
+                frame.statsBufferMemory,
+                families);
+            vkMapMemory(device.device(), frame.statsBufferMemory, 0, sizeof(uint32_t) * 2, 0, reinterpret_cast<void **>(&frame.mappedStats));
+            frame.mappedStats[0] = 0;
+            frame.mappedStats[1] = 0;
+
+            frame.descriptorSet = descriptorAllocator.allocate(frameSetLayout);
+            DescriptorWriter{}
+                .writeBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.drawBuffer)
+                .writeBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.statsBuffer)
+                .update(device, frame.descriptorSet);
+        }
+    }
+
+    void MeshletCullingSystem::createAsyncComputeResources()
+    {
+        for (auto &frame : frames)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = device.getComputeCommandPool();
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device.device(), &allocInfo, &frame.computeCommandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate culling command buffer");
+            }
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &frame.cullFinished) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create culling semaphore");
+            }
+        }
+    }
+
+    void MeshletCullingSystem::createPipelineLayout()
+    {
+        auto layout = pipelineManager.getReflectedPipelineLayout({"meshlet_cull.comp"});
+        if (layout.setLayouts.size() != 2 || layout.pushConstantSize != sizeof(MeshletCullPushConstantData))
+        {
+            throw std::runtime_error("meshlet_cull.comp does not match MeshletCullPushConstantData and the meshlet and frame sets");
+        }
+
+        pipelineLayout = layout.pipelineLayout;
+        meshletSetLayout = layout.setLayouts[0];
+        frameSetLayout = layout.setLayouts[1];
+    }
+
+    void MeshletCullingSystem::createPipeline()
+    {
+        pipeline = pipelineManager.getComputePipeline("meshlet_cull.comp", pipelineLayout);
+    }
+
+    void MeshletCullingSystem::reloadPipeline()
+    {
+        try
+        {
+            createPipeline();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "keeping the current culling pipeline: " << e.what() << std::endl;
+        }
+    }
+
+    VkSemaphore MeshletCullingSystem::cull(VkCommandBuffer commandBuffer, int frameIndex, std::vector<GameObject> &gameObjects, const Camera &camera)
+    {
+        currentFrame = frameIndex;
+        auto &frame = frames[frameIndex];
+
+        // the timeline wait in beginFrame guarantees the last submission using this slot has finished; on the
+        // async path that includes the compute work, as the graphics submission waited for its semaphore
+        bool async = frame.computeCommandBuffer != VK_NULL_HANDLE;
+        if (async)
+        {
+            commandBuffer = frame.computeCommandBuffer;
+            vkResetCommandBuffer(commandBuffer, 0);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        }
+
+        stats.meshlets = frame.submittedMeshlets;
+        stats.visibleMeshlets = frame.mappedStats[0];
+        stats.visibleTriangles = frame.mappedStats[1];
+        frame.mappedStats[0] = 0;
+        frame.mappedStats[1] = 0;
+        frame.submittedMeshlets = 0;
+        drawRanges.clear();
+
+        pipeline->bind(commandBuffer);
+        VkDescriptorSet descriptorSets[] = {meshletDescriptorSet, frame.descriptorSet};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+
+        auto projectionView = camera.getProjection() * camera.getView();
+        glm::vec4 cameraPosition = glm::inverse(camera.getView())[3];
+
+        for (auto &gameObject : gameObjects)
+        {
+            if (!gameObject.model || !gameObject.model->hasMeshlets())
+            {
+                continue;
+            }
+
+            auto modelMatrix = gameObject.transform.mat4();
+            uint32_t lod = SimpleRenderSystem::selectLod(gameObject, modelMatrix, camera);
+            const auto &lodInfo = gameObject.model->getLod(lod);
+            if (lodInfo.meshletCount == 0 || frame.submittedMeshlets + lodInfo.meshletCount > MAX_DRAWS_PER_FRAME)
+            {
+                continue;
+            }
+
+            MeshletCullPushConstantData push{};
+            extractFrustumPlanes(projectionView * modelMatrix, push.frustum);
+            push.cameraPosition = glm::inverse(modelMatrix) * cameraPosition;
+            push.firstMeshlet = gameObject.model->getFirstMeshlet() + lodInfo.firstMeshlet;
+            push.meshletCount = lodInfo.meshletCount;
+            push.firstDraw = frame.submittedMeshlets;
+
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullPushConstantData), &push);
+            vkCmdDispatch(commandBuffer, (lodInfo.meshletCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+            drawRanges[gameObject.getId()] = {frame.submittedMeshlets, lodInfo.meshletCount};
+            frame.submittedMeshlets += lodInfo.meshletCount;
+        }
+
+        if (drawRanges.empty())
+        {
+            if (async)
+            {
+                vkEndCommandBuffer(commandBuffer);
+            }
+            return VK_NULL_HANDLE;
+        }
+
+        // the semaphore makes the draws visible to the graphics queue, only the host read needs a barrier there
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = async ? VK_ACCESS_HOST_READ_BIT : VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            async ? VK_PIPELINE_STAGE_HOST_BIT : VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+
+        if (!async)
+        {
+            return VK_NULL_HANDLE;
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record culling command buffer");
+        }
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &frame.cullFinished;
+        device.submit(QueueType::Compute, submitInfo);
+        return frame.cullFinished;
+    }
+
+    bool MeshletCullingSystem::draw(VkCommandBuffer commandBuffer, const GameObject &gameObject) const
+    {
+        auto found = drawRanges.find(gameObject.getId());
+        if (found == drawRanges.end())
+        {
+            return false;
+        }
+
+        const auto &range = found->second;
+        const auto &frame = frames[currentFrame];
+        uint32_t maxDrawCount = device.capabilities.multiDrawIndirect ? device.properties.limits.maxDrawIndirectCount : 1;
+
+        for (uint32_t first = 0; first < range.drawCount; first += maxDrawCount)
+        {
+            uint32_t drawCount = std::min(maxDrawCount, range.drawCount - first);
+            VkDeviceSize offset = sizeof(VkDrawIndexedIndirectCommand) * (range.firstDraw + first);
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        return true;
+    }
+}
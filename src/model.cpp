@@ -1,12 +1,25 @@
 #include "utils.hpp"
 #include "model.hpp"
+#include "mesh_optimizer.hpp"
+#include "geometry_pool.hpp"
+#include "file_view.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <streambuf>
+#include <thread>
 #include <unordered_map>
 
 namespace std
@@ -25,110 +38,152 @@ namespace std
 
 namespace hex
 {
-    Model::Model(Device &device, const Model::Builder &builder) : device{device}
+    // Lets stream based parsers read a FileView in place
+    class ViewStreamBuffer : public std::streambuf
     {
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
-    }
-
-    Model::~Model()
-    {
-        vkDestroyBuffer(device.device(), vertexBuffer, nullptr);
-        vkFreeMemory(device.device(), vertexBufferMemory, nullptr);
-
-        if (hasIndexBuffer)
+    public:
+        explicit ViewStreamBuffer(const FileView &file)
         {
-            vkDestroyBuffer(device.device(), indexBuffer, nullptr);
-            vkFreeMemory(device.device(), indexBufferMemory, nullptr);
+            char *begin = const_cast<char *>(file.data());
+            setg(begin, begin, begin + file.size());
         }
-    }
+    };
 
-    void Model::createVertexBuffers(const std::vector<Vertex> &vertices)
+    struct MeshCacheHeader
     {
-        vertexCount = static_cast<uint32_t>(vertices.size());
-        assert(vertexCount >= 3 && "Vertex count must be at least 3");
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-        VkBuffer staggingBuffer;
-        VkDeviceMemory staggingBufferMemory;
-
-        device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staggingBuffer, staggingBufferMemory);
-
-        void *data;
-        vkMapMemory(device.device(), staggingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device.device(), staggingBufferMemory);
-
-        device.createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-        device.copyBuffer(staggingBuffer, vertexBuffer, bufferSize);
+        static constexpr uint32_t MAGIC = 0x4d584548; // "HEXM"
+        static constexpr uint32_t VERSION = 3;
+        static constexpr uint32_t FLAG_OPTIMIZED = 1u << 0;
+
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t vertexSize = sizeof(Model::Vertex);
+        uint32_t flags = 0;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        uint32_t lodCount = 0;
+        uint32_t meshletCount = 0;
+    };
 
-        vkDestroyBuffer(device.device(), staggingBuffer, nullptr);
-        vkFreeMemory(device.device(), staggingBufferMemory, nullptr);
+    Model::Model(GeometryPool &geometryPool, const Model::Builder &builder) : Model{geometryPool, builder, geometryPool.allocate(builder)}
+    {
     }
 
-    void Model::createIndexBuffers(const std::vector<uint32_t> &indeces)
+    Model::Model(GeometryPool &geometryPool, const Model::Builder &builder, const GeometryAllocation &allocation) : geometryPool{geometryPool}, contentHash{builder.contentHash}, chunks{builder.chunks}, lods{builder.lods}
     {
-        indexCount = static_cast<uint32_t>(indeces.size());
+        assert(builder.vertices.size() >= 3 && "Vertex count must be at least 3");
+        computeBounds(builder.vertices);
+
+        vertexOffset = static_cast<int32_t>(allocation.vertices.offset);
+        vertexCount = allocation.vertices.count;
+        firstIndex = allocation.indices.offset;
+        indexCount = allocation.indices.count;
         hasIndexBuffer = indexCount > 0;
+        indexType = allocation.indexType;
+        indexBufferSize = (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)) * indexCount;
+        firstMeshlet = allocation.meshlets.offset;
+        meshletCount = allocation.meshlets.count;
 
-        if (!hasIndexBuffer)
+        if (lods.empty())
         {
-            return;
+            Lod fullDetail{};
+            fullDetail.range.indexCount = hasIndexBuffer ? indexCount : vertexCount;
+            lods.push_back(fullDetail);
         }
+    }
 
-        VkDeviceSize bufferSize = sizeof(indeces[0]) * indexCount;
-
-        VkBuffer staggingBuffer;
-        VkDeviceMemory staggingBufferMemory;
-
-        device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staggingBuffer, staggingBufferMemory);
-
-        void *data;
-        vkMapMemory(device.device(), staggingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indeces.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device.device(), staggingBufferMemory);
-
-        device.createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    Model::~Model()
+    {
+        GeometryAllocation allocation{};
+        allocation.vertices = {static_cast<uint32_t>(vertexOffset), vertexCount};
+        allocation.indices = {firstIndex, indexCount};
+        allocation.meshlets = {firstMeshlet, meshletCount};
+        allocation.indexType = indexType;
+        geometryPool.free(allocation);
+    }
 
-        device.copyBuffer(staggingBuffer, indexBuffer, bufferSize);
+    void Model::computeBounds(const std::vector<Vertex> &vertices)
+    {
+        glm::vec3 minBounds{std::numeric_limits<float>::max()};
+        glm::vec3 maxBounds{std::numeric_limits<float>::lowest()};
+        for (const auto &vertex : vertices)
+        {
+            minBounds = glm::min(minBounds, vertex.position);
+            maxBounds = glm::max(maxBounds, vertex.position);
+        }
 
-        vkDestroyBuffer(device.device(), staggingBuffer, nullptr);
-        vkFreeMemory(device.device(), staggingBufferMemory, nullptr);
+        boundingCenter = (minBounds + maxBounds) * 0.5f;
+        boundingRadius = 0.0f;
+        for (const auto &vertex : vertices)
+        {
+            boundingRadius = glm::max(boundingRadius, glm::length(vertex.position - boundingCenter));
+        }
     }
 
-    std::unique_ptr<Model> Model::createModelFromFile(Device &device, const std::string &modelname)
+    std::unique_ptr<Model> Model::createModelFromFile(GeometryPool &geometryPool, const std::string &modelname, bool optimizeMesh)
     {
         Builder builder{};
-        builder.loadModel(modelname);
-        return std::make_unique<Model>(device, builder);
+        builder.loadModel(modelname, optimizeMesh);
+        auto model = std::make_unique<Model>(geometryPool, builder);
+
+        std::cout << "model " << modelname << ": " << model->vertexCount << " vertices, " << model->indexCount << " indices ("
+                  << (model->indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit), " << model->indexBufferSize << " index bytes, "
+                  << model->lods.size() << " lods, " << model->meshletCount << " meshlets" << std::endl;
+        return model;
     }
 
-    void Model::draw(VkCommandBuffer commandBuffer)
+    void Model::draw(VkCommandBuffer commandBuffer, uint32_t lod)
     {
-        if (hasIndexBuffer)
+        assert(lod < lods.size() && "Lod index out of range");
+
+        if (hasIndexBuffer && !chunks.empty())
+        {
+            for (const auto &chunk : chunks)
+            {
+                vkCmdDrawIndexed(commandBuffer, chunk.indexCount, 1, firstIndex + chunk.firstIndex, vertexOffset + chunk.vertexOffset, 0);
+            }
+        }
+        else if (hasIndexBuffer)
         {
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+            const auto &range = lods[lod].range;
+            vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, firstIndex + range.firstIndex, vertexOffset + range.vertexOffset, 0);
         }
         else
         {
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, vertexCount, 1, static_cast<uint32_t>(vertexOffset), 0);
+        }
+    }
+
+    uint32_t Model::selectLod(float screenSizePerUnit, float maxScreenError) const
+    {
+        return MeshOptimizer::selectLod(lods, screenSizePerUnit, maxScreenError);
+    }
+
+    uint32_t Model::getTriangleCount(uint32_t lod) const
+    {
+        if (hasIndexBuffer && !chunks.empty())
+        {
+            return indexCount / 3;
         }
+        return lods[lod].range.indexCount / 3;
+    }
+
+    VkDeviceSize Model::getResidentBytes() const
+    {
+        return sizeof(Vertex) * vertexCount + indexBufferSize + sizeof(Meshlet) * meshletCount;
     }
 
     void Model::bind(VkCommandBuffer commandBuffer)
     {
-        VkBuffer buffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        geometryPool.bindVertexBuffer(commandBuffer);
 
         if (hasIndexBuffer)
         {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            geometryPool.bindIndexBuffer(commandBuffer, indexType);
         }
     }
 
-    std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
+    std::vector<VkVertexInputBindingDescription> Model::getVertexBindingDescriptions()
     {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
         bindingDescriptions[0].binding = 0;
@@ -137,9 +192,10 @@ namespace hex
         return bindingDescriptions;
     }
 
-    std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions()
+    std::vector<VkVertexInputAttributeDescription> Model::getVertexAttributeDescriptions()
     {
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+        // everything the vertex buffer holds, pipelines only fetch what their vertex shader reads
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
         attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -149,25 +205,331 @@ namespace hex
         attributeDescriptions[1].location = 1;
         attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
         attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(Vertex, normal);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[3].offset = offsetof(Vertex, uv);
         return attributeDescriptions;
     }
 
-    void Model::Builder::loadModel(const std::string &modelname)
+    void Model::Builder::loadModel(const std::string &modelname, bool optimizeMesh)
+    {
+        std::string filepath = "models/" + modelname + ".obj";
+        std::string cachepath = "models/" + modelname + ".mesh";
+
+        if (!loadMeshCache(cachepath, filepath, optimizeMesh))
+        {
+            loadObj(filepath);
+            if (optimizeMesh)
+            {
+                optimize();
+                generateLods();
+                generateMeshlets();
+            }
+            saveMeshCache(cachepath);
+        }
+
+        contentHash = computeContentHash();
+    }
+
+    uint64_t Model::Builder::computeContentHash() const
+    {
+        // everything that ends up in the pool
+        uint64_t hash = hashBytes(vertices.data(), sizeof(Vertex) * vertices.size());
+        hash = hashBytes(indices.data(), sizeof(uint32_t) * indices.size(), hash);
+        hash = hashBytes(chunks.data(), sizeof(IndexRange) * chunks.size(), hash);
+        hash = hashBytes(lods.data(), sizeof(Lod) * lods.size(), hash);
+        hash = hashBytes(meshlets.data(), sizeof(Meshlet) * meshlets.size(), hash);
+        return hash == 0 ? 1 : hash;
+    }
+
+    void Model::Builder::optimize()
+    {
+        if (indices.empty())
+        {
+            return;
+        }
+
+        auto before = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+        indices = MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+        MeshOptimizer::optimizeOverdraw(indices, vertices);
+        MeshOptimizer::optimizeVertexFetch(vertices, indices);
+        optimized = true;
+
+        auto after = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+        std::cout << "mesh optimized: " << indices.size() / 3 << " triangles, ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+
+    void Model::Builder::splitIndexChunks(uint32_t maxChunkVertices)
+    {
+        chunks.clear();
+        if (vertices.size() <= maxChunkVertices)
+        {
+            return;
+        }
+
+        constexpr uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertices.size(), unmapped);
+        std::vector<uint32_t> chunkSources;
+        std::vector<Vertex> chunkedVertices;
+        std::vector<uint32_t> chunkedIndices;
+        chunkedVertices.reserve(vertices.size());
+        chunkedIndices.reserve(indices.size());
+
+        IndexRange current{};
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            uint32_t newVertices = (remap[a] == unmapped) + (b != a && remap[b] == unmapped) + (c != a && c != b && remap[c] == unmapped);
+
+            if (chunkSources.size() + newVertices > maxChunkVertices)
+            {
+                current.indexCount = static_cast<uint32_t>(chunkedIndices.size()) - current.firstIndex;
+                chunks.push_back(current);
+
+                for (uint32_t source : chunkSources)
+                {
+                    remap[source] = unmapped;
+                }
+                chunkSources.clear();
+
+                current.firstIndex = static_cast<uint32_t>(chunkedIndices.size());
+                current.vertexOffset = static_cast<int32_t>(chunkedVertices.size());
+            }
+
+            for (uint32_t index : {a, b, c})
+            {
+                if (remap[index] == unmapped)
+                {
+                    remap[index] = static_cast<uint32_t>(chunkSources.size());
+                    chunkSources.push_back(index);
+                    chunkedVertices.push_back(vertices[index]);
+                }
+                chunkedIndices.push_back(remap[index]);
+            }
+        }
+
+        current.indexCount = static_cast<uint32_t>(chunkedIndices.size()) - current.firstIndex;
+        chunks.push_back(current);
+
+        vertices.swap(chunkedVertices);
+        indices.swap(chunkedIndices);
+    }
+
+    void Model::Builder::generateLods(uint32_t maxLodCount, float maxRelativeError)
+    {
+        lods.clear();
+        if (indices.empty() || !chunks.empty())
+        {
+            return;
+        }
+
+        glm::vec3 minBounds{std::numeric_limits<float>::max()};
+        glm::vec3 maxBounds{std::numeric_limits<float>::lowest()};
+        for (const auto &vertex : vertices)
+        {
+            minBounds = glm::min(minBounds, vertex.position);
+            maxBounds = glm::max(maxBounds, vertex.position);
+        }
+        glm::vec3 size = maxBounds - minBounds;
+        float extent = glm::max(size.x, glm::max(size.y, size.z));
+
+        const std::vector<uint32_t> fullDetail = indices;
+        Lod lod0{};
+        lod0.range.indexCount = static_cast<uint32_t>(fullDetail.size());
+        lods.push_back(lod0);
+
+        // every level is simplified from the full detail mesh so its error bound is absolute, not cumulative
+        size_t targetIndexCount = fullDetail.size();
+        while (lods.size() < maxLodCount)
+        {
+            targetIndexCount = targetIndexCount / 2 / 3 * 3;
+            if (targetIndexCount < MIN_LOD_TRIANGLES * 3)
+            {
+                break;
+            }
+
+            float error = 0.0f;
+            auto lodIndices = MeshOptimizer::simplify(fullDetail, vertices, targetIndexCount, maxRelativeError, &error);
+
+            // the error budget no longer buys a meaningful reduction
+            if (lodIndices.size() * 4 > lods.back().range.indexCount * 3)
+            {
+                break;
+            }
+
+            lodIndices = MeshOptimizer::optimizeVertexCache(lodIndices, vertices.size());
+
+            Lod lod{};
+            lod.range.firstIndex = static_cast<uint32_t>(indices.size());
+            lod.range.indexCount = static_cast<uint32_t>(lodIndices.size());
+            lod.error = error * extent;
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+            lods.push_back(lod);
+
+            std::cout << "lod " << lods.size() - 1 << ": " << lodIndices.size() / 3 << " triangles, error " << error << " of extent" << std::endl;
+            targetIndexCount = lodIndices.size();
+        }
+
+        if (lods.size() == 1)
+        {
+            lods.clear();
+        }
+    }
+
+    void Model::Builder::generateMeshlets(uint32_t maxVertices, uint32_t maxTriangles)
+    {
+        meshlets.clear();
+        if (indices.empty() || !chunks.empty())
+        {
+            return;
+        }
+
+        if (lods.empty())
+        {
+            Lod fullDetail{};
+            fullDetail.range.indexCount = static_cast<uint32_t>(indices.size());
+            lods.push_back(fullDetail);
+        }
+
+        for (auto &lod : lods)
+        {
+            auto lodMeshlets = MeshOptimizer::buildMeshlets(indices, vertices, lod.range.firstIndex, lod.range.indexCount, maxVertices, maxTriangles);
+            for (auto &meshlet : lodMeshlets)
+            {
+                meshlet.vertexOffset = lod.range.vertexOffset;
+            }
+
+            lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+            lod.meshletCount = static_cast<uint32_t>(lodMeshlets.size());
+            meshlets.insert(meshlets.end(), lodMeshlets.begin(), lodMeshlets.end());
+        }
+
+        uint32_t coneCount = static_cast<uint32_t>(std::count_if(meshlets.begin(), meshlets.end(), [](const Meshlet &meshlet)
+                                                                 { return meshlet.coneCutoff < 1.0f; }));
+        std::cout << "meshlets: " << meshlets.size() << " over " << lods.size() << " lods, " << coneCount << " with normal cones" << std::endl;
+    }
+
+    bool Model::Builder::loadMeshCache(const std::string &filepath, const std::string &sourcePath, bool optimizeMesh)
+    {
+        std::error_code ec;
+        auto cacheTime = std::filesystem::last_write_time(filepath, ec);
+        if (ec || cacheTime < std::filesystem::last_write_time(sourcePath, ec) || ec)
+        {
+            return false;
+        }
+
+        std::optional<FileView> file;
+        try
+        {
+            file.emplace(filepath);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+
+        MeshCacheHeader header{};
+        if (file->size() < sizeof(header))
+        {
+            return false;
+        }
+        memcpy(&header, file->data(), sizeof(header));
+        bool cachedOptimized = (header.flags & MeshCacheHeader::FLAG_OPTIMIZED) != 0;
+        if (header.magic != MeshCacheHeader::MAGIC || header.version != MeshCacheHeader::VERSION ||
+            header.vertexSize != sizeof(Vertex) || cachedOptimized != optimizeMesh)
+        {
+            return false;
+        }
+
+        size_t expectedSize = sizeof(header) + sizeof(Vertex) * size_t{header.vertexCount} + sizeof(uint32_t) * size_t{header.indexCount} +
+                              sizeof(Lod) * size_t{header.lodCount} + sizeof(Meshlet) * size_t{header.meshletCount};
+        if (file->size() != expectedSize)
+        {
+            return false;
+        }
+
+        // the only copy between the page cache and the staging buffer
+        const char *cursor = file->data() + sizeof(header);
+        auto readArray = [&cursor](auto &array, uint32_t count)
+        {
+            array.resize(count);
+            memcpy(array.data(), cursor, sizeof(array[0]) * count);
+            cursor += sizeof(array[0]) * count;
+        };
+        readArray(vertices, header.vertexCount);
+        readArray(indices, header.indexCount);
+        readArray(lods, header.lodCount);
+        readArray(meshlets, header.meshletCount);
+
+        optimized = cachedOptimized;
+        return true;
+    }
+
+    void Model::Builder::saveMeshCache(const std::string &filepath) const
+    {
+        // the cache is only an accelerator, a read-only models directory just means we bake every run. Written
+        // aside and renamed into place so loader threads baking the same model never read a partial file
+        std::string tempPath = filepath + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open())
+        {
+            return;
+        }
+
+        MeshCacheHeader header{};
+        header.flags = optimized ? MeshCacheHeader::FLAG_OPTIMIZED : 0;
+        header.vertexCount = static_cast<uint32_t>(vertices.size());
+        header.indexCount = static_cast<uint32_t>(indices.size());
+        header.lodCount = static_cast<uint32_t>(lods.size());
+        header.meshletCount = static_cast<uint32_t>(meshlets.size());
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(vertices.data()), sizeof(Vertex) * vertices.size());
+        file.write(reinterpret_cast<const char *>(indices.data()), sizeof(uint32_t) * indices.size());
+        file.write(reinterpret_cast<const char *>(lods.data()), sizeof(Lod) * lods.size());
+        file.write(reinterpret_cast<const char *>(meshlets.data()), sizeof(Meshlet) * meshlets.size());
+        file.close();
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, filepath, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+        }
+    }
+
+    void Model::Builder::loadObj(const std::string &filepath)
     {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        std::string filepath = "models/" + modelname + ".obj";
-
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+        // parse straight out of the mapped file instead of through an ifstream buffer
+        FileView file{filepath};
+        ViewStreamBuffer streamBuffer{file};
+        std::istream stream{&streamBuffer};
+        tinyobj::MaterialFileReader materialReader{""};
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader))
         {
             throw std::runtime_error(warn + err);
         }
 
         vertices.clear();
         indices.clear();
+        chunks.clear();
+        lods.clear();
+        meshlets.clear();
+        optimized = false;
 
         std::unordered_map<Vertex, uint32_t> uniqueVertices{};
         for (const auto &shape : shapes)
@@ -0,0 +1,223 @@
+#include "model_loader.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace hex
+{
+    ModelLoader::ModelLoader(GeometryPool &geometryPool, uint32_t workerCount) : geometryPool{geometryPool}
+    {
+        if (workerCount == 0)
+        {
+            // leave a core to the render loop
+            workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        }
+
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            workers.emplace_back(&ModelLoader::workerLoop, this);
+        }
+    }
+
+    ModelLoader::~ModelLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        for (auto &upload : uploads)
+        {
+            geometryPool.finishUpload(upload.batch);
+            for (const auto &allocation : upload.allocations)
+            {
+                geometryPool.free(allocation);
+            }
+        }
+    }
+
+    std::shared_future<std::shared_ptr<Model>> ModelLoader::loadModel(const std::string &modelname, Callback onLoaded, bool optimizeMesh)
+    {
+        auto request = std::make_unique<Request>();
+        request->modelname = modelname;
+        request->optimizeMesh = optimizeMesh;
+        request->onLoaded = std::move(onLoaded);
+        std::shared_future<std::shared_ptr<Model>> future = request->promise.get_future().share();
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queued.push_back(std::move(request));
+        }
+        workAvailable.notify_one();
+
+        return future;
+    }
+
+    void ModelLoader::workerLoop()
+    {
+        while (true)
+        {
+            std::unique_ptr<Request> request;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                workAvailable.wait(lock, [this]
+                                   { return stopping || !queued.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                request = std::move(queued.front());
+                queued.pop_front();
+                parsing++;
+            }
+
+            try
+            {
+                request->builder = std::make_unique<Model::Builder>();
+                request->builder->loadModel(request->modelname, request->optimizeMesh);
+            }
+            catch (...)
+            {
+                request->builder.reset();
+                request->error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            parsed.push_back(std::move(request));
+            parsing--;
+        }
+    }
+
+    void ModelLoader::update()
+    {
+        for (auto it = uploads.begin(); it != uploads.end();)
+        {
+            if (geometryPool.isUploadComplete(it->batch))
+            {
+                publish(*it);
+                it = uploads.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        submitParsed();
+    }
+
+    void ModelLoader::submitParsed()
+    {
+        std::vector<std::unique_ptr<Request>> ready;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            ready.reserve(parsed.size());
+            while (!parsed.empty())
+            {
+                ready.push_back(std::move(parsed.front()));
+                parsed.pop_front();
+            }
+        }
+
+        PendingUpload upload{};
+        std::vector<const Model::Builder *> builders;
+        VkDeviceSize batchBytes = 0;
+
+        auto submit = [&]()
+        {
+            if (upload.requests.empty())
+            {
+                return;
+            }
+
+            try
+            {
+                upload.allocations = geometryPool.allocate(builders, upload.batch);
+                uploads.push_back(std::move(upload));
+            }
+            catch (...)
+            {
+                std::cerr << "failed to upload " << upload.requests.size() << " models" << std::endl;
+                for (auto &request : upload.requests)
+                {
+                    request->promise.set_exception(std::current_exception());
+                }
+            }
+
+            upload = {};
+            builders.clear();
+            batchBytes = 0;
+        };
+
+        for (auto &request : ready)
+        {
+            if (request->error)
+            {
+                try
+                {
+                    std::rethrow_exception(request->error);
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "failed to load model " << request->modelname << ": " << e.what() << std::endl;
+                }
+                catch (...)
+                {
+                    std::cerr << "failed to load model " << request->modelname << std::endl;
+                }
+                request->promise.set_exception(request->error);
+                continue;
+            }
+
+            VkDeviceSize size = GeometryPool::getUploadSize(*request->builder);
+            if (!builders.empty() && batchBytes + size > MAX_BATCH_BYTES)
+            {
+                submit();
+            }
+            batchBytes += size;
+            builders.push_back(request->builder.get());
+            upload.requests.push_back(std::move(request));
+        }
+        submit();
+    }
+
+    void ModelLoader::publish(PendingUpload &upload)
+    {
+        geometryPool.finishUpload(upload.batch);
+
+        for (size_t i = 0; i < upload.requests.size(); i++)
+        {
+            auto &request = *upload.requests[i];
+            auto model = std::make_shared<Model>(geometryPool, *request.builder, upload.allocations[i]);
+            request.builder.reset();
+
+            request.promise.set_value(model);
+            if (request.onLoaded)
+            {
+                request.onLoaded(model);
+            }
+        }
+        upload.allocations.clear();
+    }
+
+    bool ModelLoader::isIdle() const
+    {
+        return getPendingCount() == 0;
+    }
+
+    uint32_t ModelLoader::getPendingCount() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        uint32_t pending = static_cast<uint32_t>(queued.size() + parsed.size()) + parsing;
+        for (const auto &upload : uploads)
+        {
+            pending += static_cast<uint32_t>(upload.requests.size());
+        }
+        return pending;
+    }
+}
@@ -0,0 +1,194 @@
+#include "model_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace hex
+{
+    ModelRegistry::ModelRegistry(ModelLoader &modelLoader, VkDeviceSize budgetBytes) : modelLoader{modelLoader}, budgetBytes{budgetBytes}
+    {
+    }
+
+    std::shared_future<std::shared_ptr<Model>> ModelRegistry::acquire(const std::string &modelname, ModelLoader::Callback onLoaded, bool optimizeMesh)
+    {
+        stats.requests++;
+        std::string key = optimizeMesh ? modelname : modelname + "#unoptimized";
+
+        auto found = entries.find(key);
+        if (found != entries.end())
+        {
+            stats.hits++;
+            Entry &entry = found->second;
+            entry.lastUsed = frame;
+            if (onLoaded)
+            {
+                if (entry.loading.valid())
+                {
+                    entry.waiting.push_back(std::move(onLoaded));
+                }
+                else
+                {
+                    onLoaded(entry.model.get());
+                }
+            }
+            return entry.model;
+        }
+
+        stats.misses++;
+        Entry &entry = entries[key];
+        entry.loading = modelLoader.loadModel(modelname, nullptr, optimizeMesh);
+        entry.model = entry.promise.get_future().share();
+        entry.lastUsed = frame;
+        if (onLoaded)
+        {
+            entry.waiting.push_back(std::move(onLoaded));
+        }
+        return entry.model;
+    }
+
+    void ModelRegistry::update()
+    {
+        frame++;
+
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            Entry &entry = it->second;
+            if (!entry.loading.valid() || entry.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+
+            std::shared_ptr<Model> model;
+            try
+            {
+                model = entry.loading.get();
+            }
+            catch (...)
+            {
+                // forget the failure so a later acquire retries
+                entry.promise.set_exception(std::current_exception());
+                it = entries.erase(it);
+                continue;
+            }
+
+            resolve(entry, std::move(model));
+            ++it;
+        }
+
+        evict();
+    }
+
+    void ModelRegistry::resolve(Entry &entry, std::shared_ptr<Model> model)
+    {
+        if (model->getContentHash() != 0)
+        {
+            auto &known = contents[model->getContentHash()];
+            if (auto existing = known.lock())
+            {
+                // the duplicate's geometry goes back to the pool once the loader's future lets go of it
+                model = existing;
+                stats.contentHits++;
+            }
+            else
+            {
+                known = model;
+            }
+        }
+
+        entry.loading = {};
+        entry.promise.set_value(model);
+        for (auto &onLoaded : entry.waiting)
+        {
+            onLoaded(model);
+        }
+        entry.waiting.clear();
+    }
+
+    void ModelRegistry::evict()
+    {
+        struct Resident
+        {
+            long registryRefs = 0;
+            long useCount = 0;
+            VkDeviceSize bytes = 0;
+            uint64_t lastUsed = 0;
+            std::vector<std::string> keys;
+        };
+
+        std::unordered_map<const Model *, Resident> residents;
+        for (const auto &[key, entry] : entries)
+        {
+            if (entry.loading.valid())
+            {
+                continue;
+            }
+
+            const auto &model = entry.model.get();
+            auto &resident = residents[model.get()];
+            resident.registryRefs++;
+            resident.useCount = model.use_count();
+            resident.bytes = model->getResidentBytes();
+            resident.lastUsed = std::max(resident.lastUsed, entry.lastUsed);
+            resident.keys.push_back(key);
+        }
+
+        stats.residentModels = static_cast<uint32_t>(residents.size());
+        stats.residentBytes = 0;
+        for (const auto &[model, resident] : residents)
+        {
+            stats.residentBytes += resident.bytes;
+        }
+        if (stats.residentBytes <= budgetBytes)
+        {
+            return;
+        }
+
+        // only models referenced from nowhere but the registry entries themselves can go
+        std::vector<const Resident *> unused;
+        for (const auto &[model, resident] : residents)
+        {
+            if (resident.useCount == resident.registryRefs)
+            {
+                unused.push_back(&resident);
+            }
+        }
+        std::sort(unused.begin(), unused.end(), [](const Resident *a, const Resident *b)
+                  { return a->lastUsed < b->lastUsed; });
+
+        for (const Resident *resident : unused)
+        {
+            if (stats.residentBytes <= budgetBytes)
+            {
+                break;
+            }
+
+            for (const auto &key : resident->keys)
+            {
+                entries.erase(key);
+            }
+            stats.residentModels--;
+            stats.residentBytes -= resident->bytes;
+            stats.evictions++;
+            stats.evictedBytes += resident->bytes;
+        }
+
+        for (auto it = contents.begin(); it != contents.end();)
+        {
+            it = it->second.expired() ? contents.erase(it) : std::next(it);
+        }
+    }
+
+    bool ModelRegistry::isIdle() const
+    {
+        for (const auto &[key, entry] : entries)
+        {
+            if (entry.loading.valid())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -2,10 +2,10 @@
 
 #include "model.hpp"
 
-#include <fstream>
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 
 namespace hex
 {
@@ -14,32 +14,22 @@ namespace hex
         createGraphicsPipeline(vertShaderName, fragShaderName, config);
     }
 
-    Pipeline::~Pipeline()
+    Pipeline::Pipeline(Device &device, const std::string &compShaderName, VkPipelineLayout pipelineLayout) : device{device}, bindPoint{VK_PIPELINE_BIND_POINT_COMPUTE}
     {
-        vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
+        createComputePipeline(compShaderName, pipelineLayout);
     }
 
-    std::vector<char> Pipeline::readShader(const std::string &shaderName)
+    Pipeline::Pipeline(Device &device, VkPipeline pipeline, VkPipelineBindPoint bindPoint) : device{device}, pipeline{pipeline}, bindPoint{bindPoint}
     {
-        std::string filepath = "shaders/" + shaderName + ".spv";
-
-        std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-        if (!file.is_open())
-        {
-            throw std::runtime_error("failed to open file: " + filepath);
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+    }
 
-        file.close();
-        return buffer;
+    Pipeline::~Pipeline()
+    {
+        // frames in flight may still be drawing with it, e.g. right after a shader reload swapped it out
+        VkDevice logicalDevice = device.device();
+        VkPipeline retired = pipeline;
+        device.destroyDeferred([logicalDevice, retired]()
+                               { vkDestroyPipeline(logicalDevice, retired, nullptr); });
     }
 
     void Pipeline::defaultPipelineConigInfo(PipelineConfigInfo &configInfo)
@@ -112,20 +102,33 @@ namespace hex
         configInfo.dynamicStateInfo.flags = 0;
     }
 
-    void Pipeline::createGraphicsPipeline(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config)
+    std::vector<VkVertexInputAttributeDescription> Pipeline::selectVertexAttributes(const ShaderReflection &vertReflection)
+    {
+        auto available = Model::getVertexAttributeDescriptions();
+
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        for (const auto &input : vertReflection.vertexInputs)
+        {
+            auto found = std::find_if(available.begin(), available.end(), [&](const VkVertexInputAttributeDescription &attribute)
+                                      { return attribute.location == input.location; });
+            if (found == available.end())
+            {
+                throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) + ", which Model::Vertex does not provide");
+            }
+            attributes.push_back(*found);
+        }
+        return attributes;
+    }
+
+    void Pipeline::prepareGraphicsPipeline(Device &device, const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config, GraphicsCreateState &state)
     {
         assert(config.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in config");
         assert(config.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in config");
-        auto vertCode = readShader(vertShaderName);
-        auto fragCode = readShader(fragShaderName);
 
-        createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
-
-        VkPipelineShaderStageCreateInfo shaderStages[2];
+        auto &shaderStages = state.shaderStages;
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].module = device.getShaderModule(vertShaderName);
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
@@ -133,22 +136,42 @@ namespace hex
 
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].module = device.getShaderModule(fragShaderName);
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
         shaderStages[1].pSpecializationInfo = nullptr;
 
-        auto bindingDescriptions = Model::Vertex::getBindingDescriptions();
-        auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        const SpecializationConstants *specializations[2] = {&config.vertSpecialization, &config.fragSpecialization};
+        for (int i = 0; i < 2; i++)
+        {
+            if (specializations[i]->empty())
+            {
+                continue;
+            }
+            auto &specializationInfo = state.specializationInfos[i];
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(specializations[i]->entries.size());
+            specializationInfo.pMapEntries = specializations[i]->entries.data();
+            specializationInfo.dataSize = specializations[i]->data.size();
+            specializationInfo.pData = specializations[i]->data.data();
+            shaderStages[i].pSpecializationInfo = &specializationInfo;
+        }
+
+        state.attributeDescriptions = selectVertexAttributes(device.getShaderReflection(vertShaderName));
+        if (!state.attributeDescriptions.empty())
+        {
+            state.bindingDescriptions = Model::getVertexBindingDescriptions();
+        }
+        auto &vertexInputInfo = state.vertexInputInfo;
+        vertexInputInfo = {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.attributeDescriptions.size());
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(state.bindingDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = state.attributeDescriptions.data();
+        vertexInputInfo.pVertexBindingDescriptions = state.bindingDescriptions.data();
 
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        auto &pipelineInfo = state.createInfo;
+        pipelineInfo = {};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineInfo.stageCount = 2;
         pipelineInfo.pStages = shaderStages;
@@ -167,28 +190,41 @@ namespace hex
 
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    }
 
-        if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    void Pipeline::createGraphicsPipeline(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config)
+    {
+        GraphicsCreateState state{};
+        prepareGraphicsPipeline(device, vertShaderName, fragShaderName, config, state);
+
+        if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &state.createInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create graphics pipeline");
         }
     }
 
-    void Pipeline::bind(VkCommandBuffer commandBuffer)
-    {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-    }
-
-    void Pipeline::createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule)
+    void Pipeline::createComputePipeline(const std::string &compShaderName, VkPipelineLayout pipelineLayout)
     {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = device.getShaderModule(compShaderName);
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
+        if (vkCreateComputePipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
-            throw std::runtime_error("failed to create shder module");
+            throw std::runtime_error("failed to create compute pipeline");
         }
     }
+
+    void Pipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,507 @@
+#include "pipeline_manager.hpp"
+
+#include "model.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace hex
+{
+    static void appendStencilOp(PipelineManager::PipelineKey &key, const VkStencilOpState &state)
+    {
+        key.append(state.failOp, state.passOp, state.depthFailOp, state.compareOp, state.compareMask, state.writeMask, state.reference);
+    }
+
+    static void appendSpecialization(PipelineManager::PipelineKey &key, const SpecializationConstants &specialization)
+    {
+        key.append(specialization.entries.size());
+        for (const auto &entry : specialization.entries)
+        {
+            key.append(entry.constantID, entry.offset, entry.size);
+        }
+        key.append(specialization.data.size());
+        key.appendBytes(specialization.data.data(), specialization.data.size());
+    }
+
+    void PipelineManager::PipelineKey::appendBytes(const void *data, size_t size)
+    {
+        const auto *begin = static_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+
+    void PipelineManager::PipelineKey::seal()
+    {
+        hash = static_cast<size_t>(hashBytes(bytes.data(), bytes.size()));
+    }
+
+    PipelineManager::PipelineManager(Device &device, uint32_t workerCount) : device{device}, descriptorLayoutCache{device}
+    {
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (vkCreatePipelineCache(device.device(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline cache");
+        }
+
+        if (workerCount == 0)
+        {
+            // compiles are rare and heavy, don't crowd out the model loader
+            workerCount = std::max(1u, std::thread::hardware_concurrency() / 4);
+        }
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            workers.emplace_back(&PipelineManager::workerLoop, this);
+        }
+    }
+
+    PipelineManager::~PipelineManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        jobs.clear();
+        pending.clear();
+        pipelines.clear();
+        for (auto &[key, pipelineLayout] : pipelineLayouts)
+        {
+            vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+        }
+        vkDestroyPipelineCache(device.device(), pipelineCache, nullptr);
+    }
+
+    VkPipelineLayout PipelineManager::getPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts, const std::vector<VkPushConstantRange> &pushConstantRanges)
+    {
+        PipelineKey key;
+        key.append(setLayouts.size());
+        for (auto setLayout : setLayouts)
+        {
+            key.append(setLayout);
+        }
+        for (const auto &range : pushConstantRanges)
+        {
+            key.append(range.stageFlags, range.offset, range.size);
+        }
+        key.seal();
+
+        std::lock_guard<std::mutex> lock{mutex};
+        auto &pipelineLayout = pipelineLayouts[key];
+        if (pipelineLayout != VK_NULL_HANDLE)
+        {
+            return pipelineLayout;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        {
+            pipelineLayouts.erase(key);
+            throw std::runtime_error("failed to create pipeline layout");
+        }
+        return pipelineLayout;
+    }
+
+    VkDescriptorSetLayout PipelineManager::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+    {
+        return descriptorLayoutCache.getLayout(bindings);
+    }
+
+    PipelineManager::ReflectedLayout PipelineManager::getReflectedPipelineLayout(const std::vector<std::string> &shaderNames, const std::vector<std::pair<uint32_t, uint32_t>> &dynamicBuffers,
+                                                                                const std::vector<std::pair<uint32_t, VkDescriptorSetLayout>> &externalSets)
+    {
+        // set number -> binding number -> binding, ordered so layouts come out the same for the same shaders
+        std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+        ReflectedLayout layout{};
+        uint32_t pushConstantBegin = UINT32_MAX;
+        uint32_t pushConstantEnd = 0;
+
+        for (const auto &shaderName : shaderNames)
+        {
+            ShaderReflection reflection = device.getShaderReflection(shaderName);
+            for (const auto &reflected : reflection.descriptorBindings)
+            {
+                // runtime sized arrays get a single descriptor until variable counts are supported
+                uint32_t descriptorCount = std::max(1u, reflected.descriptorCount);
+
+                auto &bindings = sets[reflected.set];
+                auto found = bindings.find(reflected.binding);
+                if (found == bindings.end())
+                {
+                    VkDescriptorSetLayoutBinding binding{};
+                    binding.binding = reflected.binding;
+                    binding.descriptorType = reflected.descriptorType;
+                    binding.descriptorCount = descriptorCount;
+                    binding.stageFlags = reflection.stage;
+                    bindings.emplace(reflected.binding, binding);
+                }
+                else if (found->second.descriptorType != reflected.descriptorType || found->second.descriptorCount != descriptorCount)
+                {
+                    throw std::runtime_error("shaders disagree about set " + std::to_string(reflected.set) + " binding " + std::to_string(reflected.binding) + " in " + shaderName);
+                }
+                else
+                {
+                    found->second.stageFlags |= reflection.stage;
+                }
+            }
+
+            if (reflection.pushConstantSize > 0)
+            {
+                // one range for every stage, so all of them can be pushed in one call
+                layout.pushConstantStages |= reflection.stage;
+                pushConstantBegin = std::min(pushConstantBegin, reflection.pushConstantOffset);
+                pushConstantEnd = std::max(pushConstantEnd, reflection.pushConstantOffset + reflection.pushConstantSize);
+            }
+        }
+
+        // SPIR-V cannot tell whether a buffer is bound with a dynamic offset, the caller can
+        for (const auto &[set, number] : dynamicBuffers)
+        {
+            auto found = sets.find(set);
+            if (found == sets.end() || found->second.count(number) == 0)
+            {
+                throw std::runtime_error("no buffer at set " + std::to_string(set) + " binding " + std::to_string(number) + " to make dynamic");
+            }
+            auto &binding = found->second[number];
+            if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            {
+                binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            }
+            else if (binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            {
+                binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            }
+        }
+
+        uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+        for (const auto &[set, setLayout] : externalSets)
+        {
+            setCount = std::max(setCount, set + 1);
+        }
+        for (uint32_t set = 0; set < setCount; set++)
+        {
+            auto external = std::find_if(externalSets.begin(), externalSets.end(), [set = set](const auto &entry)
+                                         { return entry.first == set; });
+            if (external != externalSets.end())
+            {
+                layout.setLayouts.push_back(external->second);
+                continue;
+            }
+
+            // sets a shader skips still need a layout, an empty one
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            auto found = sets.find(set);
+            if (found != sets.end())
+            {
+                for (const auto &[number, binding] : found->second)
+                {
+                    bindings.push_back(binding);
+                }
+            }
+            layout.setLayouts.push_back(getDescriptorSetLayout(bindings));
+        }
+
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        if (layout.pushConstantStages != 0)
+        {
+            VkPushConstantRange range{};
+            range.stageFlags = layout.pushConstantStages;
+            range.offset = pushConstantBegin;
+            range.size = pushConstantEnd - pushConstantBegin;
+            pushConstantRanges.push_back(range);
+            layout.pushConstantSize = pushConstantEnd;
+        }
+
+        layout.pipelineLayout = getPipelineLayout(layout.setLayouts, pushConstantRanges);
+        return layout;
+    }
+
+    PipelineManager::PipelineKey PipelineManager::graphicsPipelineKey(Device &device, const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config)
+    {
+        PipelineKey key;
+        key.append(VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+        // modules are deduplicated by content, so equal code under other names still matches
+        key.append(device.getShaderModule(vertShaderName), device.getShaderModule(fragShaderName));
+        // each set of constant values is its own variant of the same modules
+        appendSpecialization(key, config.vertSpecialization);
+        appendSpecialization(key, config.fragSpecialization);
+
+        auto bindings = Model::getVertexBindingDescriptions();
+        key.append(bindings.size());
+        for (const auto &binding : bindings)
+        {
+            key.append(binding.binding, binding.stride, binding.inputRate);
+        }
+        auto attributes = Pipeline::selectVertexAttributes(device.getShaderReflection(vertShaderName));
+        key.append(attributes.size());
+        for (const auto &attribute : attributes)
+        {
+            key.append(attribute.location, attribute.binding, attribute.format, attribute.offset);
+        }
+
+        const auto &inputAssembly = config.inputAssemblyInfo;
+        key.append(inputAssembly.topology, inputAssembly.primitiveRestartEnable);
+
+        // viewports and scissors are dynamic, only their counts are baked in
+        key.append(config.viewportInfo.viewportCount, config.viewportInfo.scissorCount);
+
+        const auto &rasterization = config.rasterizationCreateInfo;
+        key.append(rasterization.depthClampEnable, rasterization.rasterizerDiscardEnable, rasterization.polygonMode, rasterization.cullMode,
+                   rasterization.frontFace, rasterization.depthBiasEnable, rasterization.depthBiasConstantFactor, rasterization.depthBiasClamp,
+                   rasterization.depthBiasSlopeFactor, rasterization.lineWidth);
+
+        const auto &multisample = config.multisampleInfo;
+        key.append(multisample.rasterizationSamples, multisample.sampleShadingEnable, multisample.minSampleShading,
+                   multisample.alphaToCoverageEnable, multisample.alphaToOneEnable);
+
+        const auto &colorBlend = config.colorBlendInfo;
+        key.append(colorBlend.logicOpEnable, colorBlend.logicOp, colorBlend.attachmentCount, colorBlend.blendConstants);
+        for (uint32_t i = 0; i < colorBlend.attachmentCount; i++)
+        {
+            const auto &attachment = colorBlend.pAttachments[i];
+            key.append(attachment.blendEnable, attachment.srcColorBlendFactor, attachment.dstColorBlendFactor, attachment.colorBlendOp,
+                       attachment.srcAlphaBlendFactor, attachment.dstAlphaBlendFactor, attachment.alphaBlendOp, attachment.colorWriteMask);
+        }
+
+        const auto &depthStencil = config.depthStencilInfo;
+        key.append(depthStencil.depthTestEnable, depthStencil.depthWriteEnable, depthStencil.depthCompareOp, depthStencil.depthBoundsTestEnable,
+                   depthStencil.minDepthBounds, depthStencil.maxDepthBounds, depthStencil.stencilTestEnable);
+        appendStencilOp(key, depthStencil.front);
+        appendStencilOp(key, depthStencil.back);
+
+        key.append(config.dynamicStateInfo.dynamicStateCount);
+        for (uint32_t i = 0; i < config.dynamicStateInfo.dynamicStateCount; i++)
+        {
+            key.append(config.dynamicStateInfo.pDynamicStates[i]);
+        }
+
+        key.append(config.pipelineLayout, config.renderPass, config.subpass);
+        key.seal();
+        return key;
+    }
+
+    std::shared_ptr<Pipeline> PipelineManager::getGraphicsPipeline(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config)
+    {
+        return getGraphicsPipelines({{vertShaderName, fragShaderName, &config}})[0];
+    }
+
+    std::vector<std::shared_ptr<Pipeline>> PipelineManager::getGraphicsPipelines(const std::vector<GraphicsPipelineRequest> &requests)
+    {
+        std::vector<std::shared_ptr<Pipeline>> result(requests.size());
+        std::vector<PipelineKey> keys(requests.size());
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            keys[i] = graphicsPipelineKey(device, requests[i].vertShaderName, requests[i].fragShaderName, *requests[i].config);
+        }
+
+        // requests missing from the cache, a state repeated within the batch is only created once
+        std::vector<size_t> missing;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            std::unordered_map<PipelineKey, size_t, PipelineKeyHash> missingByKey;
+            for (size_t i = 0; i < requests.size(); i++)
+            {
+                auto found = pipelines.find(keys[i]);
+                if (found != pipelines.end())
+                {
+                    stats.hits++;
+                    result[i] = found->second;
+                }
+                else if (missingByKey.count(keys[i]) == 0)
+                {
+                    stats.misses++;
+                    missingByKey[keys[i]] = missing.size();
+                    missing.push_back(i);
+                }
+                else
+                {
+                    stats.hits++;
+                }
+            }
+        }
+
+        if (!missing.empty())
+        {
+            // sized up front, the create infos point into their states
+            std::vector<Pipeline::GraphicsCreateState> states(missing.size());
+            std::vector<VkGraphicsPipelineCreateInfo> createInfos(missing.size());
+            for (size_t i = 0; i < missing.size(); i++)
+            {
+                const auto &request = requests[missing[i]];
+                Pipeline::prepareGraphicsPipeline(device, request.vertShaderName, request.fragShaderName, *request.config, states[i]);
+                createInfos[i] = states[i].createInfo;
+            }
+
+            std::vector<VkPipeline> created(missing.size(), VK_NULL_HANDLE);
+            auto start = std::chrono::high_resolution_clock::now();
+            VkResult createResult = vkCreateGraphicsPipelines(device.device(), pipelineCache, static_cast<uint32_t>(createInfos.size()), createInfos.data(), nullptr, created.data());
+            float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            if (createResult != VK_SUCCESS)
+            {
+                for (auto pipeline : created)
+                {
+                    vkDestroyPipeline(device.device(), pipeline, nullptr);
+                }
+                throw std::runtime_error("failed to create graphics pipelines");
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            stats.batches++;
+            stats.compileMilliseconds += milliseconds;
+            for (size_t i = 0; i < missing.size(); i++)
+            {
+                // a background compile of the same state may have won the race, keep the published one
+                pipelines.emplace(keys[missing[i]], std::make_shared<Pipeline>(device, created[i], VK_PIPELINE_BIND_POINT_GRAPHICS));
+            }
+            std::cout << "pipeline manager: created " << missing.size() << " graphics pipelines in one batch in " << milliseconds << " ms, " << pipelines.size() << " cached" << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            if (!result[i])
+            {
+                result[i] = pipelines[keys[i]];
+            }
+        }
+        return result;
+    }
+
+    std::shared_ptr<Pipeline> PipelineManager::getComputePipeline(const std::string &compShaderName, VkPipelineLayout pipelineLayout)
+    {
+        PipelineKey key;
+        key.append(VK_PIPELINE_BIND_POINT_COMPUTE, device.getShaderModule(compShaderName), pipelineLayout);
+        key.seal();
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            auto found = pipelines.find(key);
+            if (found != pipelines.end())
+            {
+                stats.hits++;
+                return found->second;
+            }
+            stats.misses++;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto pipeline = std::make_shared<Pipeline>(device, compShaderName, pipelineLayout);
+        float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        std::lock_guard<std::mutex> lock{mutex};
+        stats.compileMilliseconds += milliseconds;
+        return pipelines.emplace(std::move(key), pipeline).first->second;
+    }
+
+    PipelineManager::PipelineFuture PipelineManager::getGraphicsPipelineAsync(const std::string &vertShaderName, const std::string &fragShaderName, const PipelineConfigInfo &config)
+    {
+        PipelineKey key = graphicsPipelineKey(device, vertShaderName, fragShaderName, config);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        auto found = pipelines.find(key);
+        if (found != pipelines.end())
+        {
+            stats.hits++;
+            std::promise<std::shared_ptr<Pipeline>> ready;
+            ready.set_value(found->second);
+            return ready.get_future().share();
+        }
+
+        auto compiling = pending.find(key);
+        if (compiling != pending.end())
+        {
+            stats.hits++;
+            return compiling->second;
+        }
+
+        stats.misses++;
+        auto job = std::make_unique<CompileJob>();
+        job->vertShaderName = vertShaderName;
+        job->fragShaderName = fragShaderName;
+        job->config = config;
+        // the copy has to point at its own state, not at the caller's
+        if (config.colorBlendInfo.pAttachments == &config.colorBlendAttachment)
+        {
+            job->config.colorBlendInfo.pAttachments = &job->config.colorBlendAttachment;
+        }
+        job->config.dynamicStateInfo.pDynamicStates = job->config.dynamicStateEnables.data();
+
+        PipelineFuture future = job->promise.get_future().share();
+        pending[key] = future;
+        job->key = std::move(key);
+        jobs.push_back(std::move(job));
+        workAvailable.notify_one();
+        return future;
+    }
+
+    void PipelineManager::workerLoop()
+    {
+        while (true)
+        {
+            std::unique_ptr<CompileJob> job;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                workAvailable.wait(lock, [this]
+                                   { return stopping || !jobs.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            try
+            {
+                Pipeline::GraphicsCreateState state{};
+                Pipeline::prepareGraphicsPipeline(device, job->vertShaderName, job->fragShaderName, job->config, state);
+
+                VkPipeline created;
+                auto start = std::chrono::high_resolution_clock::now();
+                if (vkCreateGraphicsPipelines(device.device(), pipelineCache, 1, &state.createInfo, nullptr, &created) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create graphics pipeline");
+                }
+                float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+                std::shared_ptr<Pipeline> pipeline;
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    pipeline = pipelines.emplace(job->key, std::make_shared<Pipeline>(device, created, VK_PIPELINE_BIND_POINT_GRAPHICS)).first->second;
+                    pending.erase(job->key);
+                    stats.asyncCompiles++;
+                    stats.compileMilliseconds += milliseconds;
+                }
+                job->promise.set_value(pipeline);
+            }
+            catch (...)
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    pending.erase(job->key);
+                }
+                job->promise.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    PipelineManager::Stats PipelineManager::getStats() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return stats;
+    }
+}
@@ -1,13 +1,20 @@
 #include "renderer.hpp"
 
-#include <stdexcept>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 
 namespace hex
 {
     Renderer::Renderer(Window &window, Device &device)
         : window(window), device(device)
     {
+        const char *resizeStats = std::getenv("HEX_RESIZE_STATS");
+        logResizeStats = resizeStats != nullptr && std::string{resizeStats} != "0";
         recreateSwapChain();
         createCommandBuffers();
     }
@@ -48,21 +55,34 @@ namespace hex
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device.device());
-
         if (swapChain == nullptr)
         {
             swapChain = std::make_unique<SwapChain>(device, extent);
+            return;
         }
-        else
+
+        // no idle wait: the new swapchain keeps the old one until its presents are done, its objects are then
+        // destroyed once the frames using them have retired, and the frame slots' timeline carries over
+        auto start = std::chrono::high_resolution_clock::now();
+        std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
+        swapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain);
+
+        if (!oldSwapChain->compareSwapFormats(*swapChain.get()))
         {
-            std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
-            swapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain);
+            throw std::runtime_error("Swap chain image(or depth) format has changed");
+        }
+        oldSwapChain.reset();
 
-            if (!oldSwapChain->compareSwapFormats(*swapChain.get()))
-            {
-                throw std::runtime_error("Swap chain image(or depth) format has changed");
-            }
+        float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        resizeCount++;
+        resizeTotalMilliseconds += milliseconds;
+        resizeMaxMilliseconds = std::max(resizeMaxMilliseconds, milliseconds);
+        if (logResizeStats)
+        {
+            std::cout << "swapchain recreated at " << extent.width << "x" << extent.height << " in " << milliseconds << " ms (average "
+                      << resizeTotalMilliseconds / resizeCount << " ms, worst " << resizeMaxMilliseconds << " ms over " << resizeCount << "), render pass "
+                      << (swapChain->keptRenderPass() ? "kept" : "recreated") << ", depth memory reused for " << swapChain->reusedDepthMemoryCount()
+                      << "/" << SwapChain::MAX_FRAMES_IN_FLIGHT << " frames" << std::endl;
         }
     }
 
@@ -71,6 +91,8 @@ namespace hex
         assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
         auto result = swapChain->acquireNextImage(&currentImageIndex);
+        // the wait for this frame slot just moved the GPU timeline along, free what it left behind
+        device.collectCompleted();
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
@@ -96,6 +118,13 @@ namespace hex
 
         return commandBuffer;
     }
+    void Renderer::waitBeforeRendering(VkSemaphore semaphore, VkPipelineStageFlags stage)
+    {
+        assert(isFrameStarted && "Can't wait for other queues while frame is not in progress");
+        extraWaitSemaphores.push_back(semaphore);
+        extraWaitStages.push_back(stage);
+    }
+
     void Renderer::endFrame()
     {
         assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
@@ -104,7 +133,9 @@ namespace hex
         {
             throw std::runtime_error("failed to record command buffer");
         }
-        auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, extraWaitSemaphores, extraWaitStages);
+        extraWaitSemaphores.clear();
+        extraWaitStages.clear();
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized())
         {
             window.resetWindowResizedFlag();
@@ -116,7 +147,7 @@ namespace hex
         }
 
         isFrameStarted = false;
-        currentImageIndex = (currentImageIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+        currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
     }
     void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
     {
@@ -126,7 +157,7 @@ namespace hex
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = swapChain->getRenderPass();
-        renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+        renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentFrameIndex, currentImageIndex);
 
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent();
@@ -0,0 +1,461 @@
+#include "shader_reflection.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace hex
+{
+    namespace
+    {
+        // the few parts of the SPIR-V specification reflection needs
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+        enum Op : uint32_t
+        {
+            OpEntryPoint = 15,
+            OpTypeBool = 20,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72
+        };
+
+        enum Decoration : uint32_t
+        {
+            DecorationBlock = 2,
+            DecorationBufferBlock = 3,
+            DecorationArrayStride = 6,
+            DecorationMatrixStride = 7,
+            DecorationBuiltIn = 11,
+            DecorationLocation = 30,
+            DecorationBinding = 33,
+            DecorationDescriptorSet = 34,
+            DecorationOffset = 35
+        };
+
+        enum StorageClass : uint32_t
+        {
+            StorageUniformConstant = 0,
+            StorageInput = 1,
+            StorageUniform = 2,
+            StoragePushConstant = 9,
+            StorageStorageBuffer = 12
+        };
+
+        enum ExecutionModel : uint32_t
+        {
+            ExecutionVertex = 0,
+            ExecutionTessellationControl = 1,
+            ExecutionTessellationEvaluation = 2,
+            ExecutionGeometry = 3,
+            ExecutionFragment = 4,
+            ExecutionGLCompute = 5
+        };
+
+        enum Dim : uint32_t
+        {
+            DimBuffer = 5,
+            DimSubpassData = 6
+        };
+
+        constexpr uint32_t UNSET = std::numeric_limits<uint32_t>::max();
+
+        struct Id
+        {
+            uint32_t opcode = 0;
+            // the whole defining instruction
+            const uint32_t *words = nullptr;
+            uint32_t wordCount = 0;
+
+            uint32_t set = UNSET;
+            uint32_t binding = UNSET;
+            uint32_t location = UNSET;
+            uint32_t arrayStride = 0;
+            bool block = false;
+            bool bufferBlock = false;
+            bool builtIn = false;
+            std::vector<uint32_t> memberOffsets;
+            std::vector<uint32_t> memberMatrixStrides;
+        };
+
+        class Module
+        {
+        public:
+            Module(const uint32_t *code, size_t wordCount)
+            {
+                if (wordCount < 5 || code[0] != SPIRV_MAGIC)
+                {
+                    throw std::runtime_error("not a SPIR-V module");
+                }
+                ids.resize(code[3]);
+
+                for (size_t i = 5; i < wordCount;)
+                {
+                    const uint32_t *words = code + i;
+                    uint32_t length = words[0] >> 16;
+                    uint32_t opcode = words[0] & 0xffff;
+                    if (length == 0 || i + length > wordCount)
+                    {
+                        throw std::runtime_error("truncated SPIR-V instruction");
+                    }
+                    parse(opcode, words, length);
+                    i += length;
+                }
+            }
+
+            const Id &operator[](uint32_t id) const
+            {
+                if (id >= ids.size())
+                {
+                    throw std::runtime_error("SPIR-V id out of range");
+                }
+                return ids[id];
+            }
+
+            uint32_t executionModel = UNSET;
+            std::vector<uint32_t> variables;
+
+            uint32_t constantValue(uint32_t id) const
+            {
+                const Id &constant = (*this)[id];
+                return constant.opcode == OpConstant && constant.wordCount > 3 ? constant.words[3] : 1;
+            }
+
+            // bytes a value of the type occupies in a block with explicit layout
+            uint32_t typeSize(uint32_t typeId, uint32_t matrixStride = 0) const
+            {
+                const Id &type = (*this)[typeId];
+                switch (type.opcode)
+                {
+                case OpTypeBool:
+                    return 4;
+                case OpTypeInt:
+                case OpTypeFloat:
+                    return type.words[2] / 8;
+                case OpTypeVector:
+                    return type.words[3] * typeSize(type.words[2]);
+                case OpTypeMatrix:
+                    return type.words[3] * (matrixStride ? matrixStride : typeSize(type.words[2]));
+                case OpTypeArray:
+                {
+                    uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(type.words[2]);
+                    return constantValue(type.words[3]) * stride;
+                }
+                case OpTypeStruct:
+                {
+                    uint32_t end = 0;
+                    for (uint32_t member = 0; member + 2 < type.wordCount; member++)
+                    {
+                        uint32_t offset = member < type.memberOffsets.size() ? type.memberOffsets[member] : 0;
+                        uint32_t stride = member < type.memberMatrixStrides.size() ? type.memberMatrixStrides[member] : 0;
+                        end = std::max(end, offset + typeSize(type.words[member + 2], stride));
+                    }
+                    return end;
+                }
+                default:
+                    // runtime arrays have no static size
+                    return 0;
+                }
+            }
+
+        private:
+            Id &at(uint32_t id)
+            {
+                if (id >= ids.size())
+                {
+                    throw std::runtime_error("SPIR-V id out of range");
+                }
+                return ids[id];
+            }
+
+            void define(uint32_t id, uint32_t opcode, const uint32_t *words, uint32_t length)
+            {
+                Id &entry = at(id);
+                entry.opcode = opcode;
+                entry.words = words;
+                entry.wordCount = length;
+            }
+
+            void parse(uint32_t opcode, const uint32_t *words, uint32_t length)
+            {
+                switch (opcode)
+                {
+                case OpEntryPoint:
+                    // a module with several entry points is reflected as its first
+                    if (executionModel == UNSET && length > 1)
+                    {
+                        executionModel = words[1];
+                    }
+                    break;
+                case OpDecorate:
+                    if (length > 2)
+                    {
+                        decorate(at(words[1]), words[2], length > 3 ? words[3] : 0);
+                    }
+                    break;
+                case OpMemberDecorate:
+                    if (length > 4)
+                    {
+                        Id &target = at(words[1]);
+                        uint32_t member = words[2];
+                        if (words[3] == DecorationOffset)
+                        {
+                            target.memberOffsets.resize(std::max<size_t>(target.memberOffsets.size(), member + 1), 0);
+                            target.memberOffsets[member] = words[4];
+                        }
+                        else if (words[3] == DecorationMatrixStride)
+                        {
+                            target.memberMatrixStrides.resize(std::max<size_t>(target.memberMatrixStrides.size(), member + 1), 0);
+                            target.memberMatrixStrides[member] = words[4];
+                        }
+                    }
+                    break;
+                case OpTypeBool:
+                case OpTypeInt:
+                case OpTypeFloat:
+                case OpTypeVector:
+                case OpTypeMatrix:
+                case OpTypeImage:
+                case OpTypeSampler:
+                case OpTypeSampledImage:
+                case OpTypeArray:
+                case OpTypeRuntimeArray:
+                case OpTypeStruct:
+                case OpTypePointer:
+                    if (length > 1)
+                    {
+                        define(words[1], opcode, words, length);
+                    }
+                    break;
+                case OpConstant:
+                    if (length > 3)
+                    {
+                        define(words[2], opcode, words, length);
+                    }
+                    break;
+                case OpVariable:
+                    if (length > 3)
+                    {
+                        define(words[2], opcode, words, length);
+                        variables.push_back(words[2]);
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            static void decorate(Id &target, uint32_t decoration, uint32_t value)
+            {
+                switch (decoration)
+                {
+                case DecorationBlock:
+                    target.block = true;
+                    break;
+                case DecorationBufferBlock:
+                    target.bufferBlock = true;
+                    break;
+                case DecorationArrayStride:
+                    target.arrayStride = value;
+                    break;
+                case DecorationBuiltIn:
+                    target.builtIn = true;
+                    break;
+                case DecorationLocation:
+                    target.location = value;
+                    break;
+                case DecorationBinding:
+                    target.binding = value;
+                    break;
+                case DecorationDescriptorSet:
+                    target.set = value;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            std::vector<Id> ids;
+        };
+
+        VkShaderStageFlagBits toStage(uint32_t executionModel)
+        {
+            switch (executionModel)
+            {
+            case ExecutionVertex:
+                return VK_SHADER_STAGE_VERTEX_BIT;
+            case ExecutionTessellationControl:
+                return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case ExecutionTessellationEvaluation:
+                return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case ExecutionGeometry:
+                return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case ExecutionFragment:
+                return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case ExecutionGLCompute:
+                return VK_SHADER_STAGE_COMPUTE_BIT;
+            default:
+                throw std::runtime_error("unsupported SPIR-V execution model " + std::to_string(executionModel));
+            }
+        }
+
+        // format of a 32 bit scalar or vector vertex input
+        VkFormat toVertexFormat(const Module &module, uint32_t typeId)
+        {
+            const Id *type = &module[typeId];
+            uint32_t components = 1;
+            if (type->opcode == OpTypeVector)
+            {
+                components = type->words[3];
+                type = &module[type->words[2]];
+            }
+
+            static constexpr VkFormat floatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+            static constexpr VkFormat intFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+            static constexpr VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+            if (components < 1 || components > 4 || type->words[2] != 32)
+            {
+                return VK_FORMAT_UNDEFINED;
+            }
+            if (type->opcode == OpTypeFloat)
+            {
+                return floatFormats[components - 1];
+            }
+            if (type->opcode == OpTypeInt)
+            {
+                return type->words[3] ? intFormats[components - 1] : uintFormats[components - 1];
+            }
+            return VK_FORMAT_UNDEFINED;
+        }
+
+        bool toDescriptorType(const Id &type, uint32_t storageClass, VkDescriptorType &descriptorType)
+        {
+            switch (type.opcode)
+            {
+            case OpTypeStruct:
+                descriptorType = storageClass == StorageStorageBuffer || type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                return true;
+            case OpTypeSampler:
+                descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+                return true;
+            case OpTypeSampledImage:
+                descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                return true;
+            case OpTypeImage:
+            {
+                uint32_t dim = type.words[3];
+                // 1 when used with a sampler, 2 for storage images
+                uint32_t sampled = type.words[7];
+                if (dim == DimSubpassData)
+                {
+                    descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                else if (dim == DimBuffer)
+                {
+                    descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                }
+                else
+                {
+                    descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    ShaderReflection ShaderReflection::reflect(const void *code, size_t size)
+    {
+        if (size % sizeof(uint32_t) != 0)
+        {
+            throw std::runtime_error("SPIR-V size is not a whole number of words");
+        }
+        Module module{static_cast<const uint32_t *>(code), size / sizeof(uint32_t)};
+
+        ShaderReflection reflection{};
+        reflection.stage = toStage(module.executionModel);
+
+        for (uint32_t variableId : module.variables)
+        {
+            const Id &variable = module[variableId];
+            uint32_t storageClass = variable.words[3];
+            const Id &pointer = module[variable.words[1]];
+            if (pointer.opcode != OpTypePointer)
+            {
+                continue;
+            }
+            uint32_t typeId = pointer.words[3];
+
+            if (storageClass == StoragePushConstant)
+            {
+                const Id &block = module[typeId];
+                uint32_t begin = block.memberOffsets.empty() ? 0 : *std::min_element(block.memberOffsets.begin(), block.memberOffsets.end());
+                reflection.pushConstantOffset = begin;
+                reflection.pushConstantSize = module.typeSize(typeId) - begin;
+            }
+            else if (storageClass == StorageInput && reflection.stage == VK_SHADER_STAGE_VERTEX_BIT)
+            {
+                if (variable.builtIn || variable.location == UNSET)
+                {
+                    continue;
+                }
+                VkFormat format = toVertexFormat(module, typeId);
+                if (format == VK_FORMAT_UNDEFINED)
+                {
+                    throw std::runtime_error("unsupported vertex input type at location " + std::to_string(variable.location));
+                }
+                reflection.vertexInputs.push_back({variable.location, format});
+            }
+            else if (storageClass == StorageUniformConstant || storageClass == StorageUniform || storageClass == StorageStorageBuffer)
+            {
+                if (variable.binding == UNSET)
+                {
+                    continue;
+                }
+
+                uint32_t descriptorCount = 1;
+                const Id *type = &module[typeId];
+                if (type->opcode == OpTypeArray)
+                {
+                    descriptorCount = module.constantValue(type->words[3]);
+                    type = &module[type->words[2]];
+                }
+                else if (type->opcode == OpTypeRuntimeArray)
+                {
+                    descriptorCount = 0;
+                    type = &module[type->words[2]];
+                }
+
+                VkDescriptorType descriptorType;
+                if (toDescriptorType(*type, storageClass, descriptorType))
+                {
+                    uint32_t set = variable.set == UNSET ? 0 : variable.set;
+                    reflection.descriptorBindings.push_back({set, variable.binding, descriptorType, descriptorCount});
+                }
+            }
+        }
+
+        std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(), [](const DescriptorBinding &a, const DescriptorBinding &b)
+                  { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+        std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const VertexInput &a, const VertexInput &b)
+                  { return a.location < b.location; });
+        return reflection;
+    }
+}
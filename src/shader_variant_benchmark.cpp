@@ -0,0 +1,64 @@
+#include "shader_variant_benchmark.hpp"
+
+#include <iostream>
+
+namespace hex
+{
+    ShaderVariantBenchmark::ShaderVariantBenchmark(uint32_t framesPerVariant) : framesPerVariant{framesPerVariant}
+    {
+    }
+
+    void ShaderVariantBenchmark::update(SimpleRenderSystem &renderSystem, const GpuTimer &gpuTimer)
+    {
+        if (isFinished())
+        {
+            return;
+        }
+
+        if (!started)
+        {
+            started = true;
+            startVariant(renderSystem);
+            return;
+        }
+
+        // the previous variant keeps drawing until this one's pipeline has compiled
+        if (renderSystem.isVariantPending())
+        {
+            return;
+        }
+
+        if (skip > 0)
+        {
+            skip--;
+        }
+        else if (gpuTimer.getLastMilliseconds() >= 0.0f)
+        {
+            milliseconds += gpuTimer.getLastMilliseconds();
+            samples++;
+        }
+
+        if (samples == framesPerVariant)
+        {
+            const ShaderVariant &measured = VARIANTS[variant];
+            std::cout << "shader variant " << SimpleRenderSystem::getLightingModelName(measured.lighting) << ", "
+                      << (measured.vertexColor ? "vertex colors" : "no vertex colors") << ": "
+                      << milliseconds / samples << " ms GPU/frame over " << samples << " frames" << std::endl;
+
+            variant++;
+            if (!isFinished())
+            {
+                startVariant(renderSystem);
+            }
+        }
+    }
+
+    void ShaderVariantBenchmark::startVariant(SimpleRenderSystem &renderSystem)
+    {
+        renderSystem.setShaderVariant(VARIANTS[variant]);
+        // results trail by the frames in flight, let the previous variant's drain out
+        skip = SwapChain::MAX_FRAMES_IN_FLIGHT;
+        samples = 0;
+        milliseconds = 0.0;
+    }
+}
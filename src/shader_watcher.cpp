@@ -0,0 +1,162 @@
+#include "shader_watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <utility>
+
+#if defined(__linux__)
+#define HEX_HAS_INOTIFY 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// set by the build to the glslc it compiles the shaders with and its flags
+#ifndef HEX_GLSLC_EXECUTABLE
+#define HEX_GLSLC_EXECUTABLE "glslc"
+#endif
+#ifndef HEX_GLSLC_FLAGS
+#define HEX_GLSLC_FLAGS "-O"
+#endif
+
+namespace hex
+{
+    // editors save in bursts, a change is compiled once the directory has been quiet this long
+    static constexpr int SETTLE_MILLISECONDS = 50;
+
+    ShaderWatcher::ShaderWatcher(const std::string &sourceDirectory, const std::string &outputDirectory)
+        : sourceDirectory{sourceDirectory}, outputDirectory{outputDirectory}
+    {
+#ifdef HEX_HAS_INOTIFY
+        inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyDescriptor < 0)
+        {
+            std::cerr << "shader hot reload: inotify unavailable" << std::endl;
+            return;
+        }
+
+        // editors that save through a temporary file and a rename show up as IN_MOVED_TO
+        watchDescriptor = inotify_add_watch(inotifyDescriptor, sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watchDescriptor < 0)
+        {
+            std::cerr << "shader hot reload: cannot watch " << sourceDirectory << std::endl;
+            ::close(inotifyDescriptor);
+            inotifyDescriptor = -1;
+            return;
+        }
+
+        watcher = std::thread{&ShaderWatcher::watchLoop, this};
+        std::cout << "shader hot reload: watching " << sourceDirectory << std::endl;
+#else
+        std::cerr << "shader hot reload: not supported on this platform" << std::endl;
+#endif
+    }
+
+    ShaderWatcher::~ShaderWatcher()
+    {
+        stopping = true;
+        if (watcher.joinable())
+        {
+            watcher.join();
+        }
+#ifdef HEX_HAS_INOTIFY
+        if (inotifyDescriptor >= 0)
+        {
+            ::close(inotifyDescriptor);
+        }
+#endif
+    }
+
+    bool ShaderWatcher::isShaderSource(const std::string &filename)
+    {
+        std::string extension = std::filesystem::path{filename}.extension().string();
+        return extension == ".vert" || extension == ".frag" || extension == ".comp";
+    }
+
+    std::vector<std::string> ShaderWatcher::takeCompiled()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return std::exchange(compiled, {});
+    }
+
+    void ShaderWatcher::watchLoop()
+    {
+#ifdef HEX_HAS_INOTIFY
+        std::set<std::string> changed;
+        alignas(inotify_event) char buffer[4096];
+
+        while (!stopping)
+        {
+            pollfd descriptor{inotifyDescriptor, POLLIN, 0};
+            // the timeout bounds how long shutdown waits for the thread
+            int ready = poll(&descriptor, 1, changed.empty() ? 100 : SETTLE_MILLISECONDS);
+            if (ready > 0)
+            {
+                ssize_t length;
+                while ((length = ::read(inotifyDescriptor, buffer, sizeof(buffer))) > 0)
+                {
+                    for (char *event = buffer; event < buffer + length;)
+                    {
+                        const auto *notification = reinterpret_cast<const inotify_event *>(event);
+                        if (notification->len > 0 && isShaderSource(notification->name))
+                        {
+                            changed.insert(notification->name);
+                        }
+                        event += sizeof(inotify_event) + notification->len;
+                    }
+                }
+                continue;
+            }
+
+            for (const auto &name : changed)
+            {
+                if (compile(name))
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if (std::find(compiled.begin(), compiled.end(), name) == compiled.end())
+                    {
+                        compiled.push_back(name);
+                    }
+                }
+            }
+            changed.clear();
+        }
+#endif
+    }
+
+    bool ShaderWatcher::compile(const std::string &name)
+    {
+        std::string source = sourceDirectory + "/" + name;
+        std::string output = outputDirectory + "/" + name + ".spv";
+        // the device may read the binary at any time, it must never see a partial one
+        std::string temporary = output + ".tmp";
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::string command = std::string{"\""} + HEX_GLSLC_EXECUTABLE + "\" " + HEX_GLSLC_FLAGS + " \"" + source + "\" -o \"" + temporary + "\"";
+        if (std::system(command.c_str()) != 0)
+        {
+            // glslc has already printed the errors
+            std::cerr << "shader " << name << " failed to compile, keeping the current version" << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, output, error);
+        if (error)
+        {
+            std::cerr << "shader " << name << ": cannot replace " << output << ": " << error.message() << std::endl;
+            return false;
+        }
+
+        std::cout << "shader " << name << " recompiled in "
+                  << std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count()
+                  << " ms" << std::endl;
+        return true;
+    }
+}
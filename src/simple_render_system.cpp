@@ -1,72 +1,273 @@
 #include "simple_render_system.hpp"
+#include "meshlet_culling_system.hpp"
+#include "geometry_pool.hpp"
+#include "pipeline_manager.hpp"
+#include "descriptors.hpp"
+#include "bindless_table.hpp"
 
 #include <stdexcept>
 #include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
 #include <glm/gtc/constants.hpp>
 
 namespace hex
 {
+    // set 0 binding 0, once per frame
+    struct GlobalUbo
+    {
+        glm::mat4 projection{1.0f};
+        glm::mat4 view{1.0f};
+        glm::mat4 projectionView{1.0f};
+        // seconds since start in x
+        glm::vec4 time{0.0f};
+    };
+
+    // set 0 binding 1, one per object
+    struct ObjectData
+    {
+        glm::mat4 model{1.0f};
+        glm::mat4 normalMatrix{1.0f};
+        // indices into the bindless table, ignored without one
+        uint32_t textureIndex = BindlessTable::DEFAULT_INDEX;
+        uint32_t samplerIndex = BindlessTable::DEFAULT_INDEX;
+        uint32_t padding[2];
+    };
+
     struct SimplePushConstantData
     {
-        glm::mat4 transform{1.0f};
-        alignas(16) glm::vec3 color;
+        uint32_t objectIndex;
     };
 
-    SimpleRenderSystem::SimpleRenderSystem(Device &device, VkRenderPass renderPass) : device(device)
+    SimpleRenderSystem::SimpleRenderSystem(Device &device, GeometryPool &geometryPool, PipelineManager &pipelineManager, DescriptorAllocator &descriptorAllocator, VkRenderPass renderPass,
+                                           const BindlessTable *bindlessTable)
+        : device(device), geometryPool(geometryPool), pipelineManager(pipelineManager), descriptorAllocator(descriptorAllocator), renderPass(renderPass),
+          bindlessTable(bindlessTable), fragShaderName(bindlessTable ? "simple_bindless.frag" : "simple.frag")
     {
         createPipelineLayout();
-        createPipeline(renderPass);
+        createFrameData();
+        createPipeline();
     }
 
-    SimpleRenderSystem::~SimpleRenderSystem()
+    void SimpleRenderSystem::createPipelineLayout()
     {
-        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+        std::vector<std::pair<uint32_t, VkDescriptorSetLayout>> externalSets;
+        if (bindlessTable)
+        {
+            externalSets.emplace_back(1, bindlessTable->getSetLayout());
+        }
+
+        auto layout = pipelineManager.getReflectedPipelineLayout({"simple.vert", fragShaderName}, {{0, 0}, {0, 1}}, externalSets);
+        if (layout.pushConstantSize != sizeof(SimplePushConstantData))
+        {
+            throw std::runtime_error("simple shaders push " + std::to_string(layout.pushConstantSize) + " bytes, SimplePushConstantData has " + std::to_string(sizeof(SimplePushConstantData)));
+        }
+        if (layout.setLayouts.size() != (bindlessTable ? 2u : 1u))
+        {
+            throw std::runtime_error("simple shaders must use exactly the frame set, and the bindless set when there is one");
+        }
+
+        pipelineLayout = layout.pipelineLayout;
+        pushConstantStages = layout.pushConstantStages;
+        frameSetLayout = layout.setLayouts[0];
     }
 
-    void SimpleRenderSystem::createPipelineLayout()
+    void SimpleRenderSystem::createFrameData()
     {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(SimplePushConstantData);
-
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        // 256 is the largest offset alignment a device may require, room to align the object array
+        frameData = std::make_unique<FrameBufferRing>(
+            device,
+            sizeof(GlobalUbo) + 256 + sizeof(ObjectData) * MAX_OBJECTS,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        // both point at the start of the ring, the dynamic offsets move them to this frame's data
+        frameDescriptorSet = descriptorAllocator.allocate(frameSetLayout);
+        DescriptorWriter{}
+            .writeBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frameData->getBuffer(), 0, sizeof(GlobalUbo))
+            .writeBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, frameData->getBuffer(), 0, sizeof(ObjectData) * MAX_OBJECTS)
+            .update(device, frameDescriptorSet);
+    }
+
+    void SimpleRenderSystem::configurePipeline(PipelineConfigInfo &config, const ShaderVariant &variant) const
+    {
+        Pipeline::defaultPipelineConigInfo(config);
+        config.renderPass = renderPass;
+        config.pipelineLayout = pipelineLayout;
+        if (variant.wireframe)
         {
-            throw std::runtime_error("failed to create pipeline layout");
+            config.rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_LINE;
         }
+
+        int32_t lighting = static_cast<int32_t>(variant.lighting);
+        config.vertSpecialization.set(0, lighting);
+        config.vertSpecialization.set(1, static_cast<VkBool32>(variant.vertexColor));
+        config.fragSpecialization.set(0, lighting);
+    }
+
+    void SimpleRenderSystem::createPipeline()
+    {
+        // the first pipeline has nothing to fall back to and is built right away
+        PipelineConfigInfo pipelineConfig{};
+        configurePipeline(pipelineConfig, requestedVariant);
+        pipeline = pipelineManager.getGraphicsPipeline("simple.vert", fragShaderName, pipelineConfig);
+    }
+
+    bool SimpleRenderSystem::isWireframeSupported() const
+    {
+        return device.capabilities.fillModeNonSolid;
     }
 
-    void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
+    void SimpleRenderSystem::setShaderVariant(const ShaderVariant &variant)
     {
+        if (variant.wireframe && !isWireframeSupported())
+        {
+            return;
+        }
+
+        requestedVariant = variant;
         PipelineConfigInfo pipelineConfig{};
-        Pipeline::defaultPipelineConigInfo(pipelineConfig);
-        pipelineConfig.renderPass = renderPass;
-        pipelineConfig.pipelineLayout = pipelineLayout;
-        pipeline = std::make_unique<Pipeline>(device, "simple.vert", "simple.frag", pipelineConfig);
+        configurePipeline(pipelineConfig, variant);
+        pendingPipeline = pipelineManager.getGraphicsPipelineAsync("simple.vert", fragShaderName, pipelineConfig);
     }
 
-    void SimpleRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject> &gameObjects, const Camera &camera)
+    void SimpleRenderSystem::setWireframe(bool enabled)
     {
+        ShaderVariant variant = requestedVariant;
+        variant.wireframe = enabled;
+        setShaderVariant(variant);
+    }
+
+    const char *SimpleRenderSystem::getLightingModelName(LightingModel lighting)
+    {
+        switch (lighting)
+        {
+        case LightingModel::PerVertex:
+            return "per vertex";
+        case LightingModel::PerFragment:
+            return "per fragment";
+        default:
+            return "unlit";
+        }
+    }
+
+    uint32_t SimpleRenderSystem::selectLod(const GameObject &gameObject, const glm::mat4 &modelMatrix, const Camera &camera)
+    {
+        const Model &model = *gameObject.model;
+        if (model.getLodCount() <= 1)
+        {
+            return 0;
+        }
+
+        glm::vec3 scale = glm::abs(gameObject.transform.scale);
+        float maxScale = glm::max(scale.x, glm::max(scale.y, scale.z));
+
+        // measure at the nearest point of the bounding sphere, full detail once the camera is inside it
+        glm::vec4 viewCenter = camera.getView() * modelMatrix * glm::vec4(model.getBoundingCenter(), 1.0f);
+        float nearestDepth = viewCenter.z - model.getBoundingRadius() * maxScale;
+        if (nearestDepth <= 0.0f)
+        {
+            return 0;
+        }
+
+        return model.selectLod(camera.projectedScreenSize(maxScale, nearestDepth), LOD_SCREEN_ERROR);
+    }
+
+    void SimpleRenderSystem::renderGameObjects(FrameInfo &frameInfo, std::vector<GameObject> &gameObjects, const MeshletCullingSystem *meshletCulling)
+    {
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        const Camera &camera = frameInfo.camera;
+
+        if (pendingPipeline.valid() && pendingPipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            try
+            {
+                pipeline = pendingPipeline.get();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "keeping the current pipeline: " << e.what() << std::endl;
+            }
+            pendingPipeline = {};
+        }
         pipeline->bind(commandBuffer);
 
-        auto projectionView = camera.getProjection() * camera.getView();
+        frameData->beginFrame(frameInfo.frameIndex);
+        auto global = frameData->allocate(sizeof(GlobalUbo));
+        auto objects = frameData->allocate(sizeof(ObjectData) * MAX_OBJECTS);
+
+        // view projection is multiplied in once here, the vertex shader applies it to every object
+        auto *globalUbo = static_cast<GlobalUbo *>(global.data);
+        globalUbo->projection = camera.getProjection();
+        globalUbo->view = camera.getView();
+        globalUbo->projectionView = camera.getProjection() * camera.getView();
+        globalUbo->time = glm::vec4{frameInfo.time, 0.0f, 0.0f, 0.0f};
+
+        std::array<uint32_t, 2> dynamicOffsets{global.offset, objects.offset};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+        if (bindlessTable)
+        {
+            // every texture of every object, no binds per draw
+            VkDescriptorSet bindlessSet = bindlessTable->getDescriptorSet();
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr);
+        }
+
+        auto *objectData = static_cast<ObjectData *>(objects.data);
+        uint32_t objectCount = 0;
+        stats = {};
+
+        // every model lives in the pool, only a change of index width needs another bind
+        geometryPool.bindVertexBuffer(commandBuffer);
+        stats.bufferBinds++;
+        bool indexBufferBound = false;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
 
         for (auto &gameObject : gameObjects)
         {
+            // models still streaming in are simply not drawn yet
+            if (!gameObject.model)
+            {
+                continue;
+            }
+
+            if (objectCount == MAX_OBJECTS)
+            {
+                if (!objectLimitReported)
+                {
+                    objectLimitReported = true;
+                    std::cerr << "more than " << MAX_OBJECTS << " objects, the rest are not drawn" << std::endl;
+                }
+                break;
+            }
+
+            auto modelMatrix = gameObject.transform.mat4();
+            objectData[objectCount].model = modelMatrix;
+            objectData[objectCount].normalMatrix = glm::mat4{gameObject.transform.normalMatrix()};
+            objectData[objectCount].textureIndex = gameObject.material.texture;
+            objectData[objectCount].samplerIndex = gameObject.material.sampler;
+
             SimplePushConstantData pushData{};
-            pushData.color = gameObject.color;
-            pushData.transform = projectionView * gameObject.transform.mat4();
+            pushData.objectIndex = objectCount++;
+
+            vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, sizeof(SimplePushConstantData), &pushData);
+            if (!indexBufferBound || boundIndexType != gameObject.model->getIndexType())
+            {
+                boundIndexType = gameObject.model->getIndexType();
+                indexBufferBound = true;
+                geometryPool.bindIndexBuffer(commandBuffer, boundIndexType);
+                stats.bufferBinds++;
+            }
+            stats.drawCalls++;
+
+            // visible triangles of culled objects are only known to the GPU, see MeshletCullingSystem::getStats
+            if (meshletCulling && meshletCulling->draw(commandBuffer, gameObject))
+            {
+                continue;
+            }
 
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &pushData);
-            gameObject.model->bind(commandBuffer);
-            gameObject.model->draw(commandBuffer);
+            uint32_t lod = selectLod(gameObject, modelMatrix, camera);
+            gameObject.model->draw(commandBuffer, lod);
+            stats.triangles += gameObject.model->getTriangleCount(lod);
         }
     }
 }
\ No newline at end of file
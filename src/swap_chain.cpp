@@ -1,12 +1,14 @@
 #include "swap_chain.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 #include <set>
+#include <utility>
 #include <stdexcept>
 
 namespace hex
@@ -15,76 +17,117 @@ namespace hex
     SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent)
         : device{deviceRef}, windowExtent{extent}
     {
-        init();
+        init(nullptr);
     }
 
     SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
         : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous->swapChain}
     {
-        init();
+        init(previous.get());
         oldSwapChain = VK_NULL_HANDLE;
+
+        // its presents may still be queued, waiting on its per image semaphores; it stays alive until they are done
+        retiredSwapChains = std::move(previous->retiredSwapChains);
+        previous->retiredSwapChains.clear();
+        retiredSwapChains.push_back({previous, previous->imageCount()});
     }
 
-    void SwapChain::init()
+    void SwapChain::init(SwapChain *previous)
     {
         createSwapChain();
         createImageViews();
-        createRenderPass();
-        createDepthResources();
-        createFramebuffers();
-        createSyncObjects();
-    }
-
-    SwapChain::~SwapChain()
-    {
-        for (auto imageView : swapChainImageViews)
-        {
-            vkDestroyImageView(device.device(), imageView, nullptr);
-        }
-        swapChainImageViews.clear();
-
-        if (swapChain != nullptr)
-        {
-            vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
-            swapChain = nullptr;
-        }
-
-        for (int i = 0; i < depthImages.size(); i++)
-        {
-            vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-            vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
-        }
-
-        for (auto framebuffer : swapChainFramebuffers)
+        // pipelines were built against the render pass, which only depends on the formats
+        if (previous != nullptr && previous->renderPass != VK_NULL_HANDLE &&
+            previous->swapChainImageFormat == swapChainImageFormat && previous->swapChainDepthFormat == findDepthFormat())
         {
-            vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+            renderPass = std::exchange(previous->renderPass, VK_NULL_HANDLE);
+            renderPassKept = true;
         }
-
-        vkDestroyRenderPass(device.device(), renderPass, nullptr);
-
-        // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        else
         {
-            vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+            createRenderPass();
         }
+        createDepthResources(previous);
+        createFramebuffers();
+        createSyncObjects(previous);
+    }
 
-        // Освобождаем семафоры renderFinished для каждого изображения свопчейна
-        for (size_t i = 0; i < renderFinishedSemaphores.size(); i++)
-        {
-            vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-        }
+    SwapChain::~SwapChain()
+    {
+        // the next swapchain only lets go of this one once its presents are done, but frames rendered to it may
+        // still be in flight, so everything goes once the GPU is done with them rather than after an idle wait
+        VkDevice logicalDevice = device.device();
+        device.destroyDeferred([logicalDevice,
+                                swapChain = swapChain,
+                                imageViews = swapChainImageViews,
+                                depthImages = depthImages,
+                                depthImageViews = depthImageViews,
+                                depthImageMemorys = depthImageMemorys,
+                                framebuffers = swapChainFramebuffers,
+                                renderPass = renderPass,
+                                imageAvailableSemaphores = imageAvailableSemaphores,
+                                renderFinishedSemaphores = renderFinishedSemaphores,
+                                pendingPresentFences = pendingPresentFences,
+                                freePresentFences = freePresentFences]()
+                               {
+                                   // already signaled unless the device is shutting down with presents queued
+                                   if (!pendingPresentFences.empty())
+                                   {
+                                       vkWaitForFences(logicalDevice, static_cast<uint32_t>(pendingPresentFences.size()), pendingPresentFences.data(),
+                                                       VK_TRUE, std::numeric_limits<uint64_t>::max());
+                                   }
+                                   for (auto fence : pendingPresentFences)
+                                   {
+                                       vkDestroyFence(logicalDevice, fence, nullptr);
+                                   }
+                                   for (auto fence : freePresentFences)
+                                   {
+                                       vkDestroyFence(logicalDevice, fence, nullptr);
+                                   }
+
+                                   for (auto framebuffer : framebuffers)
+                                   {
+                                       vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+                                   }
+
+                                   for (auto imageView : imageViews)
+                                   {
+                                       vkDestroyImageView(logicalDevice, imageView, nullptr);
+                                   }
+
+                                   if (swapChain != VK_NULL_HANDLE)
+                                   {
+                                       vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+                                   }
+
+                                   for (size_t i = 0; i < depthImages.size(); i++)
+                                   {
+                                       vkDestroyImageView(logicalDevice, depthImageViews[i], nullptr);
+                                       vkDestroyImage(logicalDevice, depthImages[i], nullptr);
+                                       // VK_NULL_HANDLE when the next swapchain took the memory over
+                                       vkFreeMemory(logicalDevice, depthImageMemorys[i], nullptr);
+                                   }
+
+                                   if (renderPass != VK_NULL_HANDLE)
+                                   {
+                                       vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
+                                   }
+
+                                   for (auto semaphore : imageAvailableSemaphores)
+                                   {
+                                       vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+                                   }
+                                   // one per swapchain image, its presents are done with them by now
+                                   for (auto semaphore : renderFinishedSemaphores)
+                                   {
+                                       vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+                                   }
+                               });
     }
 
     VkResult SwapChain::acquireNextImage(uint32_t *imageIndex)
     {
-        vkWaitForFences(
-            device.device(),
-            1,
-            &inFlightFences[currentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
+        device.waitFor(framesInFlight[currentFrame]);
 
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -98,22 +141,21 @@ namespace hex
     }
 
     VkResult SwapChain::submitCommandBuffers(
-        const VkCommandBuffer *buffers, uint32_t *imageIndex)
+        const VkCommandBuffer *buffers, uint32_t *imageIndex,
+        const std::vector<VkSemaphore> &extraWaitSemaphores, const std::vector<VkPipelineStageFlags> &extraWaitStages)
     {
-        if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-        {
-            vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-        }
-        imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+        device.waitFor(imagesInFlight[*imageIndex]);
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        std::vector<VkSemaphore> waitSemaphores = {imageAvailableSemaphores[currentFrame]};
+        std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        waitSemaphores.insert(waitSemaphores.end(), extraWaitSemaphores.begin(), extraWaitSemaphores.end());
+        waitStages.insert(waitStages.end(), extraWaitStages.begin(), extraWaitStages.end());
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
@@ -124,12 +166,8 @@ namespace hex
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-            VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to submit draw command buffer!");
-        }
+        framesInFlight[currentFrame] = device.submit(QueueType::Graphics, submitInfo);
+        imagesInFlight[*imageIndex] = framesInFlight[currentFrame];
 
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -143,13 +181,97 @@ namespace hex
 
         presentInfo.pImageIndices = imageIndex;
 
+        VkFence presentFence = VK_NULL_HANDLE;
+#ifdef VK_EXT_swapchain_maintenance1
+        VkSwapchainPresentFenceInfoEXT presentFenceInfo = {};
+        if (device.capabilities.swapchainMaintenance1)
+        {
+            presentFence = acquirePresentFence();
+            presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+            presentFenceInfo.swapchainCount = 1;
+            presentFenceInfo.pFences = &presentFence;
+            presentInfo.pNext = &presentFenceInfo;
+        }
+#endif
+
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
+        if (presentFence != VK_NULL_HANDLE)
+        {
+            // out of date presents are still queued and signal their fence, other errors queue nothing
+            if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                pendingPresentFences.push_back(presentFence);
+            }
+            else
+            {
+                freePresentFences.push_back(presentFence);
+            }
+        }
+
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        releaseRetiredSwapChains();
 
         return result;
     }
 
+    VkFence SwapChain::acquirePresentFence()
+    {
+        recyclePresentFences();
+        if (!freePresentFences.empty())
+        {
+            VkFence fence = freePresentFences.back();
+            freePresentFences.pop_back();
+            return fence;
+        }
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create present fence!");
+        }
+        return fence;
+    }
+
+    void SwapChain::recyclePresentFences()
+    {
+        auto firstPending = std::stable_partition(pendingPresentFences.begin(), pendingPresentFences.end(), [&](VkFence fence)
+                                                  { return vkGetFenceStatus(device.device(), fence) == VK_SUCCESS; });
+        if (firstPending == pendingPresentFences.begin())
+        {
+            return;
+        }
+        vkResetFences(device.device(), static_cast<uint32_t>(firstPending - pendingPresentFences.begin()), pendingPresentFences.data());
+        freePresentFences.insert(freePresentFences.end(), pendingPresentFences.begin(), firstPending);
+        pendingPresentFences.erase(pendingPresentFences.begin(), firstPending);
+    }
+
+    bool SwapChain::presentsComplete()
+    {
+        recyclePresentFences();
+        return pendingPresentFences.empty();
+    }
+
+    void SwapChain::releaseRetiredSwapChains()
+    {
+        // present fences tell exactly when the presentation engine is done with a swapchain. Without them the
+        // graphics timeline says nothing about presents, which FIFO can keep queued for as many frames as the
+        // swapchain has images
+        bool presentFences = device.capabilities.swapchainMaintenance1;
+        auto released = std::remove_if(retiredSwapChains.begin(), retiredSwapChains.end(), [&](RetiredSwapChain &retired)
+                                       {
+                                           if (retired.framesLeft > 0)
+                                           {
+                                               retired.framesLeft--;
+                                           }
+                                           return presentFences ? retired.swapChain->presentsComplete() : retired.framesLeft == 0;
+                                       });
+        // their destructors defer the actual destruction past the frames in flight
+        retiredSwapChains.erase(released, retiredSwapChains.end());
+    }
+
     void SwapChain::createSwapChain()
     {
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
@@ -276,8 +398,10 @@ namespace hex
         VkSubpassDependency dependency = {};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        // late tests too: the previous frame's depth writes must finish before the memory is cleared again,
+        // including depth memory a recreated swapchain took over
         dependency.srcStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
         dependency.dstSubpass = 0;
         dependency.dstStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
@@ -302,41 +426,47 @@ namespace hex
 
     void SwapChain::createFramebuffers()
     {
-        swapChainFramebuffers.resize(imageCount());
-        for (size_t i = 0; i < imageCount(); i++)
+        swapChainFramebuffers.resize(MAX_FRAMES_IN_FLIGHT * imageCount());
+        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
         {
-            std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
-
-            VkExtent2D swapChainExtent = getSwapChainExtent();
-            VkFramebufferCreateInfo framebufferInfo = {};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-            framebufferInfo.pAttachments = attachments.data();
-            framebufferInfo.width = swapChainExtent.width;
-            framebufferInfo.height = swapChainExtent.height;
-            framebufferInfo.layers = 1;
-
-            if (vkCreateFramebuffer(
-                    device.device(),
-                    &framebufferInfo,
-                    nullptr,
-                    &swapChainFramebuffers[i]) != VK_SUCCESS)
+            for (size_t i = 0; i < imageCount(); i++)
             {
-                throw std::runtime_error("failed to create framebuffer!");
+                std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[frame]};
+
+                VkExtent2D swapChainExtent = getSwapChainExtent();
+                VkFramebufferCreateInfo framebufferInfo = {};
+                framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebufferInfo.renderPass = renderPass;
+                framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+                framebufferInfo.pAttachments = attachments.data();
+                framebufferInfo.width = swapChainExtent.width;
+                framebufferInfo.height = swapChainExtent.height;
+                framebufferInfo.layers = 1;
+
+                if (vkCreateFramebuffer(
+                        device.device(),
+                        &framebufferInfo,
+                        nullptr,
+                        &swapChainFramebuffers[frame * imageCount() + i]) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create framebuffer!");
+                }
             }
         }
     }
 
-    void SwapChain::createDepthResources()
+    void SwapChain::createDepthResources(SwapChain *previous)
     {
         VkFormat depthFormat = findDepthFormat();
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
-        depthImages.resize(imageCount());
-        depthImageMemorys.resize(imageCount());
-        depthImageViews.resize(imageCount());
+        // only the frames in flight render at once, and depth never outlives their render pass
+        depthImages.resize(MAX_FRAMES_IN_FLIGHT);
+        depthImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+        depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+        depthMemorySizes.resize(MAX_FRAMES_IN_FLIGHT);
+        depthMemoryTypes.resize(MAX_FRAMES_IN_FLIGHT);
 
         for (int i = 0; i < depthImages.size(); i++)
         {
@@ -351,16 +481,57 @@ namespace hex
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
-            device.createImageWithInfo(
-                imageInfo,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                depthImages[i],
-                depthImageMemorys[i]);
+            if (vkCreateImage(device.device(), &imageInfo, nullptr, &depthImages[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create depth image!");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device.device(), depthImages[i], &memRequirements);
+
+            // shrinking, or resizing within the old size, keeps the previous allocation; the render pass
+            // dependency orders the new frames' depth writes after the old frames'
+            bool fits = previous != nullptr && i < previous->depthImageMemorys.size() &&
+                        previous->depthImageMemorys[i] != VK_NULL_HANDLE &&
+                        memRequirements.size <= previous->depthMemorySizes[i] &&
+                        (memRequirements.memoryTypeBits & (1u << previous->depthMemoryTypes[i])) != 0;
+            if (fits)
+            {
+                depthImageMemorys[i] = std::exchange(previous->depthImageMemorys[i], VK_NULL_HANDLE);
+                depthMemorySizes[i] = previous->depthMemorySizes[i];
+                depthMemoryTypes[i] = previous->depthMemoryTypes[i];
+                depthMemoryReused++;
+            }
+            else
+            {
+                VkMemoryAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                allocInfo.allocationSize = memRequirements.size;
+                // desktop GPUs have no lazily allocated memory and get ordinary device local memory
+                if (!device.tryFindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, allocInfo.memoryTypeIndex))
+                {
+                    allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                }
+                if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &depthImageMemorys[i]) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to allocate depth image memory!");
+                }
+                depthMemorySizes[i] = allocInfo.allocationSize;
+                depthMemoryTypes[i] = allocInfo.memoryTypeIndex;
+            }
+
+            uint32_t lazyType;
+            depthLazilyAllocated = device.tryFindMemoryType(1u << depthMemoryTypes[i], VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyType);
+
+            if (vkBindImageMemory(device.device(), depthImages[i], depthImageMemorys[i], 0) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to bind depth image memory!");
+            }
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -380,27 +551,36 @@ namespace hex
         }
     }
 
-    void SwapChain::createSyncObjects()
+    void SwapChain::createSyncObjects(SwapChain *previous)
     {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         // Создаем семафоры для каждого изображения свопчейна, а не только для MAX_FRAMES_IN_FLIGHT
         renderFinishedSemaphores.resize(imageCount());
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        imagesInFlight.resize(imageCount());
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        // the frame slots carry on: acquireNextImage waits for the slot's last submission, the one that consumed
+        // its imageAvailable semaphore, before signaling it again. Per image semaphores are new, the old ones stay
+        // with the previous swapchain until its presents are done, see releaseRetiredSwapChains
+        if (previous != nullptr)
+        {
+            imageAvailableSemaphores = std::move(previous->imageAvailableSemaphores);
+            previous->imageAvailableSemaphores.clear();
+            framesInFlight = previous->framesInFlight;
+            currentFrame = previous->currentFrame;
+        }
+        else
+        {
+            imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+            framesInFlight.resize(MAX_FRAMES_IN_FLIGHT);
+        }
 
-        // Создаем семафоры imageAvailable и заборы для MAX_FRAMES_IN_FLIGHT
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        // Создаем семафоры imageAvailable для MAX_FRAMES_IN_FLIGHT
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT && previous == nullptr; i++)
         {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
-                    VK_SUCCESS ||
-                vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+                VK_SUCCESS)
             {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
@@ -473,6 +653,62 @@ namespace hex
         }
     }
 
+    void SwapChain::reportDepthMemory(Device &device)
+    {
+        SwapChainSupportDetails support = device.getSwapChainSupport();
+        uint32_t imageCount = support.capabilities.minImageCount + 1;
+        if (support.capabilities.maxImageCount > 0 && imageCount > support.capabilities.maxImageCount)
+        {
+            imageCount = support.capabilities.maxImageCount;
+        }
+
+        VkFormat depthFormat = device.findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+        auto requirements = [&](VkExtent2D extent, VkImageUsageFlags usage)
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = {extent.width, extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = depthFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VkImage image;
+            if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create depth image!");
+            }
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
+            vkDestroyImage(device.device(), image, nullptr);
+            return memRequirements;
+        };
+
+        const VkExtent2D resolutions[] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+        for (VkExtent2D extent : resolutions)
+        {
+            auto perImage = requirements(extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+            auto perFrame = requirements(extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+            uint32_t lazyType;
+            bool lazy = device.tryFindMemoryType(perFrame.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyType);
+
+            float before = imageCount * perImage.size / (1024.0f * 1024.0f);
+            float after = MAX_FRAMES_IN_FLIGHT * perFrame.size / (1024.0f * 1024.0f);
+            std::cout << "depth attachments at " << extent.width << "x" << extent.height << ": " << imageCount << " per image "
+                      << before << " MB device local, " << MAX_FRAMES_IN_FLIGHT << " per frame " << after << " MB "
+                      << (lazy ? "lazily allocated, committed only if the tiles spill" : "device local, no lazily allocated memory") << std::endl;
+        }
+    }
+
     VkFormat SwapChain::findDepthFormat()
     {
         return device.findSupportedFormat(
@@ -0,0 +1,356 @@
+// Checks MeshOptimizer::simplify against its error bound by measuring the geometry it produces rather than
+// trusting the quadric estimate it reports: points sampled over every LOD triangle must lie within
+// targetError * extent of the original surface (a sampled one-sided Hausdorff distance). Open borders must not
+// pull away either: samples along the original border edges must lie as close to the simplified surface. A vase
+// and an open heightfield are used, and the resulting chains must be walked coarser by MeshOptimizer::selectLod
+// as their projected size shrinks
+#include "mesh_optimizer.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using hex::MeshLod;
+    using hex::MeshOptimizer;
+    using hex::MeshVertex;
+
+    constexpr float PI = 3.14159265f;
+
+    struct Mesh
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    bool loadObj(const std::string &filepath, Mesh &mesh)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+        {
+            std::cerr << "failed to load " << filepath << ": " << warn << err << std::endl;
+            return false;
+        }
+
+        // one vertex per corner is enough, simplify welds by position
+        for (const auto &shape : shapes)
+        {
+            for (const auto &index : shape.mesh.indices)
+            {
+                MeshVertex vertex{};
+                vertex.position = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2],
+                };
+                vertex.color = {1.0f, 1.0f, 1.0f};
+                mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        return !mesh.indices.empty();
+    }
+
+    // Wavy resolution x resolution quad sheet, open along all four sides
+    Mesh buildOpenGrid(uint32_t resolution)
+    {
+        Mesh mesh;
+        for (uint32_t z = 0; z <= resolution; z++)
+        {
+            for (uint32_t x = 0; x <= resolution; x++)
+            {
+                float u = float(x) / resolution, v = float(z) / resolution;
+                MeshVertex vertex{};
+                vertex.position = {u, 0.1f * std::sin(2.0f * PI * u) * std::cos(PI * v), v};
+                vertex.color = {1.0f, 1.0f, 1.0f};
+                mesh.vertices.push_back(vertex);
+            }
+        }
+
+        uint32_t row = resolution + 1;
+        for (uint32_t z = 0; z < resolution; z++)
+        {
+            for (uint32_t x = 0; x < resolution; x++)
+            {
+                uint32_t corner = z * row + x;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + row, corner + 1, corner + 1, corner + row, corner + row + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 closestPointOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+        {
+            return a;
+        }
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+        {
+            return b;
+        }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            return a + ab * (d1 / (d1 - d3));
+        }
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+        {
+            return c;
+        }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            return a + ac * (d2 / (d2 - d6));
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+    // Distance queries against the original triangles, bucketed into a grid whose cells are as large as the
+    // bound: every triangle within the bound of a point is registered in the point's cell
+    class SurfaceDistance
+    {
+    public:
+        SurfaceDistance(const std::vector<MeshVertex> &vertices, const std::vector<uint32_t> &indices, glm::vec3 minBounds, float bound)
+            : vertices{vertices}, indices{indices}, minBounds{minBounds}, bound{bound}
+        {
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+            {
+                const auto &a = vertices[indices[t]].position;
+                const auto &b = vertices[indices[t + 1]].position;
+                const auto &c = vertices[indices[t + 2]].position;
+                glm::ivec3 lo = cell(glm::min(a, glm::min(b, c)) - glm::vec3{bound});
+                glm::ivec3 hi = cell(glm::max(a, glm::max(b, c)) + glm::vec3{bound});
+                for (int x = lo.x; x <= hi.x; x++)
+                    for (int y = lo.y; y <= hi.y; y++)
+                        for (int z = lo.z; z <= hi.z; z++)
+                        {
+                            cells[key({x, y, z})].push_back(static_cast<uint32_t>(t));
+                        }
+            }
+        }
+
+        // Exact distance when it is within the bound, infinity otherwise
+        float operator()(const glm::vec3 &p) const
+        {
+            auto found = cells.find(key(cell(p)));
+            if (found == cells.end())
+            {
+                return std::numeric_limits<float>::infinity();
+            }
+
+            float best = std::numeric_limits<float>::infinity();
+            for (uint32_t t : found->second)
+            {
+                const auto &a = vertices[indices[t]].position;
+                const auto &b = vertices[indices[t + 1]].position;
+                const auto &c = vertices[indices[t + 2]].position;
+                best = std::min(best, glm::length(p - closestPointOnTriangle(p, a, b, c)));
+            }
+            return best <= bound ? best : std::numeric_limits<float>::infinity();
+        }
+
+    private:
+        glm::ivec3 cell(const glm::vec3 &p) const { return glm::ivec3{glm::floor((p - minBounds) / bound)}; }
+        static uint64_t key(const glm::ivec3 &c)
+        {
+            return (uint64_t(uint32_t(c.x) & 0x1fffff) << 42) | (uint64_t(uint32_t(c.y) & 0x1fffff) << 21) | uint64_t(uint32_t(c.z) & 0x1fffff);
+        }
+
+        const std::vector<MeshVertex> &vertices;
+        const std::vector<uint32_t> &indices;
+        glm::vec3 minBounds;
+        float bound;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+    };
+
+    // Largest distance from samples on the given triangles to the surface distance measures against
+    float measureDeviation(const std::vector<MeshVertex> &vertices, const std::vector<uint32_t> &indices, const SurfaceDistance &distance)
+    {
+        constexpr int SUBDIVISIONS = 6;
+        float deviation = 0.0f;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            const auto &a = vertices[indices[t]].position;
+            const auto &b = vertices[indices[t + 1]].position;
+            const auto &c = vertices[indices[t + 2]].position;
+            for (int i = 0; i <= SUBDIVISIONS; i++)
+            {
+                for (int j = 0; i + j <= SUBDIVISIONS; j++)
+                {
+                    float u = float(i) / SUBDIVISIONS, v = float(j) / SUBDIVISIONS;
+                    deviation = std::max(deviation, distance(a + (b - a) * u + (c - a) * v));
+                }
+            }
+        }
+        return deviation;
+    }
+    // Edges used by a single triangle once corners are welded by position, as the simplifier welds them
+    std::vector<std::pair<uint32_t, uint32_t>> findBorderEdges(const Mesh &mesh)
+    {
+        std::map<std::tuple<float, float, float>, uint32_t> positionIds;
+        std::vector<uint32_t> positionOf(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            const auto &position = mesh.vertices[i].position;
+            positionOf[i] = positionIds.emplace(std::make_tuple(position.x, position.y, position.z), static_cast<uint32_t>(i)).first->second;
+        }
+
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeUse;
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                uint32_t a = positionOf[mesh.indices[t + k]], b = positionOf[mesh.indices[t + (k + 1) % 3]];
+                edgeUse[std::minmax(a, b)]++;
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> borderEdges;
+        for (const auto &[edge, uses] : edgeUse)
+        {
+            if (uses == 1)
+            {
+                borderEdges.push_back(edge);
+            }
+        }
+        return borderEdges;
+    }
+
+    float measureBorderDeviation(const Mesh &mesh, const std::vector<std::pair<uint32_t, uint32_t>> &borderEdges, const SurfaceDistance &distance)
+    {
+        constexpr int SUBDIVISIONS = 6;
+        float deviation = 0.0f;
+        for (const auto &[a, b] : borderEdges)
+        {
+            const auto &from = mesh.vertices[a].position;
+            const auto &to = mesh.vertices[b].position;
+            for (int i = 0; i <= SUBDIVISIONS; i++)
+            {
+                deviation = std::max(deviation, distance(from + (to - from) * (float(i) / SUBDIVISIONS)));
+            }
+        }
+        return deviation;
+    }
+
+    // Simplifies mesh at every target fraction, returns the number of failed checks
+    int checkMesh(const std::string &name, const Mesh &mesh, float maxRelativeError)
+    {
+        const float targetFractions[] = {0.5f, 0.25f, 0.125f, 0.0625f};
+
+        glm::vec3 minBounds{std::numeric_limits<float>::max()};
+        glm::vec3 maxBounds{std::numeric_limits<float>::lowest()};
+        for (const auto &vertex : mesh.vertices)
+        {
+            minBounds = glm::min(minBounds, vertex.position);
+            maxBounds = glm::max(maxBounds, vertex.position);
+        }
+        glm::vec3 size = maxBounds - minBounds;
+        float extent = std::max(size.x, std::max(size.y, size.z));
+        float bound = maxRelativeError * extent;
+        SurfaceDistance toOriginal{mesh.vertices, mesh.indices, minBounds, bound};
+        auto borderEdges = findBorderEdges(mesh);
+        std::cout << name << ": " << mesh.indices.size() / 3 << " triangles, " << borderEdges.size() << " border edges" << std::endl;
+
+        int failures = 0;
+        std::vector<MeshLod> lods(1);
+        lods[0].range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        for (float fraction : targetFractions)
+        {
+            size_t targetIndexCount = static_cast<size_t>(mesh.indices.size() * fraction) / 3 * 3;
+            float reportedError = 0.0f;
+            auto lodIndices = MeshOptimizer::simplify(mesh.indices, mesh.vertices, targetIndexCount, maxRelativeError, &reportedError);
+
+            float deviation = measureDeviation(mesh.vertices, lodIndices, toOriginal);
+            if (!borderEdges.empty())
+            {
+                SurfaceDistance toLod{mesh.vertices, lodIndices, minBounds, bound};
+                deviation = std::max(deviation, measureBorderDeviation(mesh, borderEdges, toLod));
+            }
+
+            bool passed = deviation <= bound;
+            (passed ? std::cout : std::cerr) << (passed ? "ok   " : "FAIL ") << name << " target " << targetIndexCount / 3
+                                             << " triangles: " << lodIndices.size() / 3 << " triangles, measured deviation "
+                                             << deviation / extent << " of extent (reported " << reportedError << ", bound "
+                                             << maxRelativeError << ")" << std::endl;
+            failures += passed ? 0 : 1;
+
+            MeshLod lod{};
+            lod.range.indexCount = static_cast<uint32_t>(lodIndices.size());
+            lod.error = reportedError * extent;
+            lods.push_back(lod);
+        }
+
+        // from filling the screen a thousand times over down to a speck, the selected level may only get coarser
+        constexpr float MAX_SCREEN_ERROR = 1.0f;
+        uint32_t previous = 0;
+        bool monotonic = true;
+        for (float screenSize = 1e6f; screenSize >= 1e-3f; screenSize *= 0.5f)
+        {
+            uint32_t selected = MeshOptimizer::selectLod(lods, screenSize / extent, MAX_SCREEN_ERROR);
+            monotonic = monotonic && selected >= previous;
+            previous = selected;
+        }
+        uint32_t nearest = MeshOptimizer::selectLod(lods, 1e6f / extent, MAX_SCREEN_ERROR);
+        uint32_t farthest = MeshOptimizer::selectLod(lods, 1e-3f / extent, MAX_SCREEN_ERROR);
+        bool passed = monotonic && nearest == 0 && farthest == lods.size() - 1;
+        (passed ? std::cout : std::cerr) << (passed ? "ok   " : "FAIL ") << name << " lod selection: level " << nearest << " up close, level "
+                                         << farthest << " far away" << (monotonic ? "" : ", not monotonic in between") << std::endl;
+        return failures + (passed ? 0 : 1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string modelDir = argc > 1 ? argv[1] : "models";
+    // the bound Model::Builder::generateLods uses by default
+    constexpr float MAX_RELATIVE_ERROR = 0.02f;
+
+    int failures = 0;
+    Mesh vase;
+    if (loadObj(modelDir + "/smooth_vase.obj", vase))
+    {
+        failures += checkMesh("smooth_vase.obj", vase, MAX_RELATIVE_ERROR);
+    }
+    else
+    {
+        failures++;
+    }
+    failures += checkMesh("open grid", buildOpenGrid(64), MAX_RELATIVE_ERROR);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}